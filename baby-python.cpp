@@ -1,102 +1,608 @@
 // Compile with:
 //
-//     c++ -std=c++11 -O3 baby-python.cpp -o baby-python
+//     c++ -std=c++11 -O3 -pthread baby-python.cpp -o baby-python
 
 //// includes //////////////////////////////////////////////////////////////
 
 #include "linenoise.hpp"
+#include "baby-python.h"
 #include <fstream>
-#include <regex>
 #include <vector>
 #include <string>
 #include <memory>
 #include <unordered_map>
 #include <chrono>
 #include <iostream>
+#include <sstream>
+#include <functional>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <future>
+#include <limits>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <cstdlib>
+#include <new>
+
+#if !defined(_WIN32)
+#define HAVE_MMAP 1
+#define HAVE_PREAD 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define HAVE_MMAP 0
+#define HAVE_PREAD 0
+#include <io.h>
+#endif
+
+// io_uring is used through its system calls directly, so it needs the kernel's header but not liburing
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#undef BLOCK_SIZE    // from <linux/fs.h>, and not ours (Arena::BLOCK_SIZE)
+#endif
+#endif
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#else
+#define HAVE_IO_URING 0
+#endif
 
 //// types /////////////////////////////////////////////////////////////////
 
 
 const int MAX_REPR = 80;
 const int MAX_RECURSION = 20;
+const int64_t MIN_CHUNK_SIZE = 1024;   // smallest piece of a list worth sending to another thread
 
 class Object;
 class ASTNode;
 class ASTDefineFun;
+class Code;
+class Resolver;
+class JitFunction;
+
+
+// the bytecode VM is the default; the tree-walker is kept as a reference
+enum EvalMode { EVAL_BYTECODE, EVAL_TREE_WALKER };
+
+EvalMode eval_mode = EVAL_BYTECODE;
+
+
+//// Values: what variables, arguments, and list items hold
+
+
+enum ValueType { VALUE_NONE, VALUE_INT, VALUE_OBJECT };
+
+// ints are stored inline, so arithmetic doesn't allocate; everything else is an Object on the heap
+class Value {
+public:
+  Value(): type_(VALUE_NONE), int_(0), object_() { }
+  Value(int value): type_(VALUE_INT), int_(value), object_() { }
+  template <typename T>
+  Value(std::shared_ptr<T> object)
+    : type_(object ? VALUE_OBJECT : VALUE_NONE), int_(0), object_(std::move(object)) { }
+
+  ValueType type() const { return type_; }
+  bool is_int() const { return type_ == VALUE_INT; }
+  int to_int() const { return int_; }
+  // nullptr unless this is an Object
+  Object* object() const { return object_.get(); }
+  const std::shared_ptr<Object>& shared_object() const { return object_; }
+
+  explicit operator bool() const { return type_ != VALUE_NONE; }
+  void reset() { *this = Value(); }
+
+  std::string repr(int& remaining) const;
+
+private:
+  ValueType type_;
+  int int_;
+  std::shared_ptr<Object> object_;
+};
+
+
+//// Symbols: names are interned as small integers when they're parsed
+
+
+int intern(const std::string& name);
+const std::string& symbol_name(int symbol);
+// whether any function's frame has a slot for the symbol (if not, it can only be a global variable)
+bool in_any_frame(int symbol);
+
+
+// where a variable is found, worked out by resolve (after parsing) so that running code doesn't
+// look up names; functions see their caller's variables, so only their own frames have fixed slots
+enum AddressKind {
+  ADDRESS_GLOBAL,   // in the global Scope, at slot 'symbol' (for code outside of any function)
+  ADDRESS_LOCAL,    // in the function's own frame, at 'slot'; if that's empty, searched for outward
+  ADDRESS_FREE      // searched for outward from the function's frame, by 'symbol'
+};
+
+struct Address {
+  Address(AddressKind kind, int symbol, int slot): kind(kind), symbol(symbol), slot(slot) { }
+
+  AddressKind kind;
+  int symbol;
+  int slot;
+};
+
+
+// the variables that a function's frame has slots for: its parameters, then the names it assigns
+struct FrameLayout {
+  std::vector<int> symbols;
+};
 
 
 //// Scope: which variables exist right now?
 
 class Scope {
 public:
-  Scope(std::shared_ptr<Scope> parent): parent_(parent), objects_() { }
+  Scope(std::shared_ptr<Scope> parent)
+    : parent_(parent), global_(parent ? parent->global_ : this), layout_(nullptr), slots_() { }
+
+  // makes this Scope a frame for 'layout', unless it's already being used for something else
+  bool enter(const FrameLayout* layout);
 
   void assign(
-    const std::string& name,
-    std::shared_ptr<Object> object,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+    const Address& address,
+    Value object,
+    std::vector<ASTNode*>& stack
   );
-  std::shared_ptr<Object> del(
-    const std::string& name,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value del(
+    const Address& address,
+    std::vector<ASTNode*>& stack
   );
-  std::shared_ptr<Object> get(
-    const std::string& name,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value get(
+    const Address& address,
+    std::vector<ASTNode*>& stack
   );
+  // like get, but nullptr rather than an error if there's no such variable
+  Value* locate(const Address& address);
+  // like locate, but straight to the global Scope for a name that no function has a variable for
+  Value* locate_callee(const Address& address);
+
+  // a new Scope under this one ('self') for a function call, which is the last call's if
+  // end_frame got it back, so that calls don't allocate
+  std::shared_ptr<Scope> begin_frame(const std::shared_ptr<Scope>& self);
+  void end_frame(std::shared_ptr<Scope>& frame);
 
 private:
+  // the variable in this Scope (not its parents), or nullptr if it's not here
+  Value* find(int symbol);
+
   std::shared_ptr<Scope> parent_;
-  std::unordered_map<std::string, std::shared_ptr<Object>> objects_;
+  Scope* global_;   // the outermost of the parent_s
+  const FrameLayout* layout_;
+  // indexed by the layout's slots in a frame, or by symbol in the global Scope
+  std::vector<Value> slots_;
+  // an empty frame for the next call (without a parent_, which would be a cycle)
+  std::shared_ptr<Scope> spare_;
 };
 
 
 //// Objects: data within the language
 
+// every kind of Object that can be made: lists first, then functions
+enum ObjectType {
+  OBJECT_LIST_BOXED,
+  OBJECT_LIST_INT32,
+  OBJECT_LIST_ARRAY,
+  OBJECT_LIST_ROPE,
+  OBJECT_LIST_RANGE,
+  OBJECT_LIST_STREAM,
+  OBJECT_LIST_VIEW,
+  OBJECT_FUNCTION_ADD,
+  OBJECT_FUNCTION_MUL,
+  OBJECT_FUNCTION_GET,
+  OBJECT_FUNCTION_LEN,
+  OBJECT_FUNCTION_SLICE,
+  OBJECT_FUNCTION_RANGE,
+  OBJECT_FUNCTION_MAP,
+  OBJECT_FUNCTION_REDUCE,
+  OBJECT_FUNCTION_THREADS,
+  OBJECT_USER_FUNCTION
+};
+
 class Object {
 public:
-  Object() { }
+  Object(ObjectType type): type_(type) { }
+
+  // checked instead of dynamic_cast, which is slow enough to show up in map and reduce
+  ObjectType type() const { return type_; }
+  bool is_list() const { return type_ <= OBJECT_LIST_VIEW; }
+  bool is_function() const { return type_ >= OBJECT_FUNCTION_ADD; }
 
   virtual std::string repr(int& remaining) const = 0;
 
 private:
+  const ObjectType type_;
 };
 
 
-class ObjectInt: public Object {
+class ObjectList: public Object {
 public:
-  ObjectInt(int value): value_(value), Object() { }
+  ObjectList(ObjectType type): Object(type) { }
 
-  int value() const { return value_; }
+  virtual int64_t size() const = 0;
+  virtual Value get(int64_t index) const = 0;
 
   std::string repr(int& remaining) const override;
 
 private:
-  int value_;
 };
 
 
-class ObjectList: public Object {
+class ObjectListBoxed: public ObjectList {
+public:
+  ObjectListBoxed(const std::vector<Value>& values): values_(values), ObjectList(OBJECT_LIST_BOXED) { }
+
+  const std::vector<Value>& values() const { return values_; }
+
+  int64_t size() const override { return values_.size(); }
+  Value get(int64_t index) const override { return values_[index]; }
+
+private:
+  const std::vector<Value> values_;
+};
+
+
+class ObjectListInt32: public ObjectList {
 public:
-  ObjectList(const std::vector<std::shared_ptr<Object>>& values): values_(values), Object() { }
+  ObjectListInt32(std::vector<int32_t>&& values);
+  // borrow 'size' items at 'data', which 'storage' keeps alive (e.g. a memory-mapped file)
+  ObjectListInt32(const int32_t* data, int64_t size, std::shared_ptr<const void> storage)
+    : data_(data), size_(size), storage_(storage), ObjectList(OBJECT_LIST_INT32) { }
+
+  const int32_t* data() const { return data_; }
+  const std::shared_ptr<const void>& storage() const { return storage_; }
 
-  const std::vector<std::shared_ptr<Object>>& values() const { return values_; }
+  int64_t size() const override { return size_; }
+  Value get(int64_t index) const override { return Value(data_[index]); }
 
   std::string repr(int& remaining) const override;
 
 private:
-  const std::vector<std::shared_ptr<Object>> values_;
+  const int32_t* data_;
+  int64_t size_;
+  std::shared_ptr<const void> storage_;
+};
+
+
+// the element types a data file can have, from its suffix (data.uint8) or given as name:dtype=path
+enum DType {
+  DTYPE_INT8,
+  DTYPE_UINT8,
+  DTYPE_INT16,
+  DTYPE_UINT16,
+  DTYPE_INT32,
+  DTYPE_UINT32,
+  DTYPE_INT64,
+  DTYPE_UINT64,
+  DTYPE_FLOAT32,
+  DTYPE_FLOAT64
+};
+
+// false if 'name' (like "uint8") isn't one
+bool parse_dtype(const std::string& name, DType& dtype);
+const char* dtype_name(DType dtype);
+int dtype_size(DType dtype);
+
+// the dtypes that ObjectListArrays hold, with their C++ types, for writing switch statements:
+// int32 is ObjectListInt32 (which everything is specialized for), and floats aren't numbers here
+#define FOR_EACH_ARRAY_DTYPE(X) \
+  X(DTYPE_INT8, int8_t) \
+  X(DTYPE_UINT8, uint8_t) \
+  X(DTYPE_INT16, int16_t) \
+  X(DTYPE_UINT16, uint16_t) \
+  X(DTYPE_UINT32, uint32_t) \
+  X(DTYPE_INT64, int64_t) \
+  X(DTYPE_UINT64, uint64_t)
+
+template <typename T> DType dtype_of();
+#define DTYPE_OF(DTYPE, T) template <> inline DType dtype_of<T>() { return DTYPE; }
+FOR_EACH_ARRAY_DTYPE(DTYPE_OF)
+#undef DTYPE_OF
+
+
+// whether an item of a data file can be an int: always, unless it's wider than an int32
+template <typename T> inline bool fits_in_int(T item) { return true; }
+template <> inline bool fits_in_int(uint32_t item) { return item <= (uint32_t)std::numeric_limits<int>::max(); }
+template <> inline bool fits_in_int(uint64_t item) { return item <= (uint64_t)std::numeric_limits<int>::max(); }
+template <> inline bool fits_in_int(int64_t item) {
+  return item >= std::numeric_limits<int>::min()  &&  item <= std::numeric_limits<int>::max();
+}
+
+// a problem with a data file's items, found where there's no stack to point into (such as in
+// ObjectList::get); the call that was running rethrows it as error(stack, ...), with arrows
+class DataError: public std::runtime_error {
+public:
+  DataError(const std::string& message): std::runtime_error(message) { }
+};
+
+// an item of a data file as an int, or a DataError if it's too big to be one
+template <typename T>
+inline int item_int(T item) {
+  if (!fits_in_int(item)) {
+    throw DataError("data file item " + std::to_string(item) + " is too big to be an integer");
+  }
+  return (int)item;
+}
+
+
+// like ObjectList::repr, for items that are stored as numbers (not Values)
+template <typename T>
+std::string repr_items(const T* data, int64_t size, int& remaining);
+
+
+// the parts of an ObjectListArray that don't depend on its type
+class ObjectListArrayBase: public ObjectList {
+public:
+  ObjectListArrayBase(DType dtype): dtype_(dtype), ObjectList(OBJECT_LIST_ARRAY) { }
+
+  DType dtype() const { return dtype_; }
+
+  // items [start, start + size) as another array, sharing these items
+  virtual std::shared_ptr<ObjectList> slice(int64_t start, int64_t size) const = 0;
+
+private:
+  DType dtype_;
+};
+
+
+// the items of a data file that isn't int32, at their own width (not converted when loaded)
+template <typename T>
+class ObjectListArray: public ObjectListArrayBase {
+public:
+  // borrow 'size' items at 'data', which 'storage' keeps alive (e.g. a memory-mapped file)
+  ObjectListArray(const T* data, int64_t size, std::shared_ptr<const void> storage)
+    : data_(data), size_(size), storage_(storage), ObjectListArrayBase(dtype_of<T>()) { }
+
+  const T* data() const { return data_; }
+  const std::shared_ptr<const void>& storage() const { return storage_; }
+
+  int64_t size() const override { return size_; }
+  Value get(int64_t index) const override { return Value(item_int(data_[index])); }
+
+  // (shows items that are too big to be integers, too)
+  std::string repr(int& remaining) const override { return repr_items(data_, size_, remaining); }
+
+  std::shared_ptr<ObjectList> slice(int64_t start, int64_t size) const override {
+    return std::make_shared<ObjectListArray<T>>(data_ + start, size, storage_);
+  }
+
+private:
+  const T* data_;
+  int64_t size_;
+  std::shared_ptr<const void> storage_;
+};
+
+
+// two lists joined end to end without copying either; add(lst, lst) makes these, keeping the
+// tree balanced (like an AVL tree) so that concatenating and get(lst, i) take O(log n) steps
+class ObjectListRope: public ObjectList {
+public:
+  ObjectListRope(std::shared_ptr<ObjectList> left, std::shared_ptr<ObjectList> right);
+
+  const std::shared_ptr<ObjectList>& left() const { return left_; }
+  const std::shared_ptr<ObjectList>& right() const { return right_; }
+  int height() const { return height_; }
+
+  int64_t size() const override { return size_; }
+  Value get(int64_t index) const override;
+
+private:
+  std::shared_ptr<ObjectList> left_;
+  std::shared_ptr<ObjectList> right_;
+  int64_t size_;
+  int height_;
+};
+
+
+// start, start + step, start + 2*step, ... (made by range): computed when they're needed, not stored
+class ObjectListRange: public ObjectList {
+public:
+  ObjectListRange(int64_t start, int64_t step, int64_t size)
+    : start_(start), step_(step), size_(size), ObjectList(OBJECT_LIST_RANGE) { }
+
+  int64_t start() const { return start_; }
+  int64_t step() const { return step_; }
+  int item(int64_t index) const { return (int)(start_ + index * step_); }
+
+  int64_t size() const override { return size_; }
+  Value get(int64_t index) const override { return Value(item(index)); }
+
+private:
+  int64_t start_;
+  int64_t step_;
+  int64_t size_;
+};
+
+
+// an open data file that ObjectListStreams read from (closed when the last of them is gone)
+class StreamFile {
+public:
+  StreamFile(const std::string& name, int fd, int read_ahead, bool use_io_uring)
+    : name_(name), fd_(fd), read_ahead_(read_ahead), use_io_uring_(use_io_uring) { }
+  ~StreamFile();
+
+  const std::string& name() const { return name_; }
+  int fd() const { return fd_; }
+  int read_ahead() const { return read_ahead_; }
+  bool use_io_uring() const { return use_io_uring_; }
+
+  // reads 'count' int32s, starting with item 'index' of the file; false if that fails
+  bool read(int64_t index, int64_t count, int32_t* out) const;
+
+private:
+  const std::string name_;
+  int fd_;
+  int read_ahead_;       // windows being read at once, beyond the one being worked on
+  bool use_io_uring_;    // otherwise (or if the kernel won't), pread on background threads
+};
+
+
+// a data file that isn't held in memory: map and reduce read it a window at a time, reading the
+// next few windows in the background while they work on one (--stream, for files larger than RAM)
+class ObjectListStream: public ObjectList {
+public:
+  ObjectListStream(std::shared_ptr<StreamFile> file, int64_t offset, int64_t size, int64_t window_size)
+    : file_(file), offset_(offset), size_(size), window_size_(window_size), ObjectList(OBJECT_LIST_STREAM) { }
+
+  const std::shared_ptr<StreamFile>& file() const { return file_; }
+  int64_t offset() const { return offset_; }
+  int64_t window_size() const { return window_size_; }
+
+  int64_t size() const override { return size_; }
+  // reads one item from the file (fine for a few, but use for_each_piece for all of them)
+  Value get(int64_t index) const override;
+
+  // reads items [start, stop) into 'out'
+  void read(int64_t start, int64_t stop, int32_t* out) const;
+
+  // calls 'body' on each window of items from 'start' on (see for_each_piece)
+  void for_each_window(
+    int64_t start,
+    std::vector<ASTNode*>& stack,
+    const std::function<void(const ObjectList* piece, int64_t start)>& body
+  ) const;
+
+private:
+  std::shared_ptr<StreamFile> file_;
+  int64_t offset_;         // of the first item, in items from the start of the file
+  int64_t size_;
+  int64_t window_size_;    // items read at a time
+};
+
+
+// bytes that ObjectListStreams have read, for the report after each expression
+extern std::atomic<int64_t> bytes_streamed;
+
+
+// every step'th item of another list, from 'start', without copying them (made by slice)
+class ObjectListView: public ObjectList {
+public:
+  ObjectListView(std::shared_ptr<ObjectList> parent, int64_t start, int64_t step, int64_t size)
+    : parent_(parent), start_(start), step_(step), size_(size), ObjectList(OBJECT_LIST_VIEW) { }
+
+  const std::shared_ptr<ObjectList>& parent() const { return parent_; }
+  int64_t start() const { return start_; }
+  int64_t step() const { return step_; }
+
+  int64_t size() const override { return size_; }
+  Value get(int64_t index) const override { return parent_->get(start_ + index * step_); }
+
+private:
+  std::shared_ptr<ObjectList> parent_;
+  int64_t start_;
+  int64_t step_;
+  int64_t size_;
+};
+
+
+// items [start, stop) of 'list', every step'th one, sharing its storage (0 <= start <= stop <= size)
+std::shared_ptr<ObjectList> slice_list(
+  const std::shared_ptr<ObjectList>& list,
+  int64_t start,
+  int64_t stop,
+  int64_t step
+);
+
+
+// lists this short are copied when concatenated, rather than becoming (or growing) a rope
+const int64_t ROPE_LEAF_SIZE = 256;
+
+// left + right, sharing the items of both (unless they're short)
+std::shared_ptr<ObjectList> concatenate(
+  const std::shared_ptr<ObjectList>& left,
+  const std::shared_ptr<ObjectList>& right
+);
+
+// calls 'body' on each in-memory piece of 'list', in order: the leaves of a rope, windows of a
+// stream, or just 'list' itself; 'body' uses the items of each piece from its 'start' on, which
+// is where item 'start' of the whole list is in the first piece, and 0 in the rest
+typedef std::function<void(const ObjectList* piece, int64_t start)> PieceBody;
+
+void for_each_piece(
+  const ObjectList* list,
+  int64_t start,
+  std::vector<ASTNode*>& stack,
+  const PieceBody& body
+);
+
+
+// collects the items of a new list, keeping them as int32s for as long as they're all integers
+class ListBuilder {
+public:
+  ListBuilder(int64_t expected_size): expected_size_(expected_size), boxed_(false) {
+    unboxed_.reserve(expected_size);
+  }
+
+  void append(Value item);
+  void extend(const ListBuilder& other);
+  std::shared_ptr<ObjectList> finish();
+
+private:
+  int64_t expected_size_;
+  bool boxed_;
+  std::vector<int32_t> unboxed_;
+  std::vector<Value> values_;
+};
+
+
+// kernels: loops over int32 arrays for add, mul, and reduce, which wrap around on overflow
+// (GCC and Clang on Linux compile them for AVX-512, AVX2, and baseline, and pick one at startup)
+int32_t sum_int32(const int32_t* data, int64_t size);
+int32_t product_int32(const int32_t* data, int64_t size);
+void add_scalar_int32(const int32_t* data, int64_t size, int32_t scalar, int32_t* out);
+void mul_scalar_int32(const int32_t* data, int64_t size, int32_t scalar, int32_t* out);
+void mul_int32(const int32_t* left, const int32_t* right, int64_t size, int32_t* out);
+
+
+// a function's arguments, borrowed from the caller (usually from its value stack) for the call
+class Args {
+public:
+  Args(): data_(nullptr), size_(0) { }
+  Args(const Value* data, int size): data_(data), size_(size) { }
+  Args(const std::vector<Value>& values): data_(values.data()), size_(values.size()) { }
+
+  int size() const { return size_; }
+  const Value& operator[](int i) const { return data_[i]; }
+
+private:
+  const Value* data_;
+  int size_;
 };
 
 
 class ObjectFunction: public Object {
 public:
-  ObjectFunction(): Object() { }
+  ObjectFunction(ObjectType type): Object(type) { }
+
+  // if f(f(a, b), c) == f(a, f(b, c)), reduce can split its list among threads
+  virtual bool associative() const { return false; }
 
-  virtual std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  // if it assigns variables (or calls functions that do), it runs in a new Scope; the others
+  // run in their caller's, so calling them doesn't allocate
+  virtual bool needs_frame() const { return false; }
+
+  virtual Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) = 0;
 
 private:
@@ -105,14 +611,16 @@ private:
 
 class ObjectFunctionAdd: public ObjectFunction {
 public:
-  ObjectFunctionAdd(): ObjectFunction() { }
+  ObjectFunctionAdd(): ObjectFunction(OBJECT_FUNCTION_ADD) { }
+
+  bool associative() const override { return true; }
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -121,14 +629,16 @@ private:
 
 class ObjectFunctionMul: public ObjectFunction {
 public:
-  ObjectFunctionMul(): ObjectFunction() { }
+  ObjectFunctionMul(): ObjectFunction(OBJECT_FUNCTION_MUL) { }
+
+  bool associative() const override { return true; }
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -137,14 +647,14 @@ private:
 
 class ObjectFunctionGet: public ObjectFunction {
 public:
-  ObjectFunctionGet(): ObjectFunction() { }
+  ObjectFunctionGet(): ObjectFunction(OBJECT_FUNCTION_GET) { }
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -153,14 +663,46 @@ private:
 
 class ObjectFunctionLen: public ObjectFunction {
 public:
-  ObjectFunctionLen(): ObjectFunction() { }
+  ObjectFunctionLen(): ObjectFunction(OBJECT_FUNCTION_LEN) { }
+
+  std::string repr(int& remaining) const override;
+
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
+  ) override;
+
+private:
+};
+
+
+class ObjectFunctionSlice: public ObjectFunction {
+public:
+  ObjectFunctionSlice(): ObjectFunction(OBJECT_FUNCTION_SLICE) { }
+
+  std::string repr(int& remaining) const override;
+
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
+  ) override;
+
+private:
+};
+
+
+class ObjectFunctionRange: public ObjectFunction {
+public:
+  ObjectFunctionRange(): ObjectFunction(OBJECT_FUNCTION_RANGE) { }
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -169,14 +711,17 @@ private:
 
 class ObjectFunctionMap: public ObjectFunction {
 public:
-  ObjectFunctionMap(): ObjectFunction() { }
+  ObjectFunctionMap(): ObjectFunction(OBJECT_FUNCTION_MAP) { }
+
+  // its function's calls share the Scope (see Scope::enter)
+  bool needs_frame() const override { return true; }
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -185,14 +730,36 @@ private:
 
 class ObjectFunctionReduce: public ObjectFunction {
 public:
-  ObjectFunctionReduce(): ObjectFunction() { }
+  ObjectFunctionReduce(): ObjectFunction(OBJECT_FUNCTION_REDUCE) { }
+
+  // its function's calls share the Scope (see Scope::enter)
+  bool needs_frame() const override { return true; }
+
+  std::string repr(int& remaining) const override;
+
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
+  ) override;
+
+private:
+};
+
+
+class ObjectFunctionThreads: public ObjectFunction {
+public:
+  ObjectFunctionThreads(): ObjectFunction(OBJECT_FUNCTION_THREADS) { }
+
+  // its function's calls share the Scope (see Scope::enter)
+  bool needs_frame() const override { return true; }
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -201,14 +768,18 @@ private:
 
 class ObjectUserFunction: public ObjectFunction {
 public:
-  ObjectUserFunction(std::shared_ptr<ASTDefineFun> fun): fun_(fun), ObjectFunction() { }
+  ObjectUserFunction(std::shared_ptr<ASTDefineFun> fun): fun_(fun), ObjectFunction(OBJECT_USER_FUNCTION) { }
+
+  bool needs_frame() const override { return true; }
+
+  JitFunction* jit();
 
   std::string repr(int& remaining) const override;
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack,
-    std::vector<std::shared_ptr<Object>> args
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack,
+    Args args
   ) override;
 
 private:
@@ -216,39 +787,98 @@ private:
 };
 
 
+// the Object as a more specific type, or nullptr if it isn't one (like dynamic_cast)
+inline ObjectList* as_list(Object* object) {
+  return object  &&  object->is_list() ? static_cast<ObjectList*>(object) : nullptr;
+}
+inline const ObjectListInt32* as_list_int32(const Object* object) {
+  return object  &&  object->type() == OBJECT_LIST_INT32 ? static_cast<const ObjectListInt32*>(object) : nullptr;
+}
+inline const ObjectListArrayBase* as_list_array(const Object* object) {
+  return object  &&  object->type() == OBJECT_LIST_ARRAY ? static_cast<const ObjectListArrayBase*>(object) : nullptr;
+}
+inline ObjectFunction* as_function(Object* object) {
+  return object  &&  object->is_function() ? static_cast<ObjectFunction*>(object) : nullptr;
+}
+inline bool has_type(const Object* object, ObjectType type) {
+  return object  &&  object->type() == type;
+}
+
+
 //// ASTNodes: sequence of instructions (as a tree) to run
 
 
+// owns every ASTNode parsed from one line and that line's text (freed all at once)
+class Arena: public std::enable_shared_from_this<Arena> {
+public:
+  Arena(const std::string& line): line_(line), used_(BLOCK_SIZE) { }
+  ~Arena();
+
+  const std::string& line() const { return line_; }
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    T* node = new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    nodes_.push_back(node);
+    return node;
+  }
+
+  // a shared_ptr to one of this Arena's nodes that keeps the whole Arena alive
+  template <typename T>
+  std::shared_ptr<T> share(T* node) {
+    return std::shared_ptr<T>(shared_from_this(), node);
+  }
+
+private:
+  static const size_t BLOCK_SIZE = 4096;
+
+  void* allocate(size_t size);
+
+  const std::string line_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  size_t used_;                  // bytes used in the last block
+  std::vector<ASTNode*> nodes_;  // to run their destructors
+};
+
+
 class ASTNode {
 public:
-  ASTNode(int pos, const std::string& line): pos_(pos), line_(line) { }
+  ASTNode(int pos, Arena* arena): pos_(pos), arena_(arena) { }
   virtual ~ASTNode() = default;
 
   int pos() const { return pos_; }
-  const std::string& line() const { return line_; }
+  Arena* arena() const { return arena_; }
+  const std::string& line() const { return arena_->line(); }
 
-  virtual std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  virtual Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) = 0;
 
+  // binds names to Addresses; must be called (via ::resolve) before run or compile
+  virtual void resolve(Resolver& resolver) = 0;
+  virtual void compile(Code& code) = 0;
+
 private:
   int pos_;
-  const std::string line_;
+  Arena* arena_;
 };
 
 class ASTLiteralInt: public ASTNode {
 public:
-  ASTLiteralInt(int pos, const std::string& line, int value)
-    : value_(value), ASTNode(pos, line) { }
+  ASTLiteralInt(int pos, Arena* arena, int value)
+    : value_(value), ASTNode(pos, arena) { }
 
   int value() const { return value_; }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
   int value_;
 };
@@ -258,70 +888,99 @@ class ASTLiteralList: public ASTNode {
 public:
   ASTLiteralList(
     int pos,
-    const std::string& line,
-    std::vector<std::shared_ptr<ASTNode>>& values
+    Arena* arena,
+    std::vector<ASTNode*>& values
   )
     : values_(values)
-    , ASTNode(pos, line) { }
+    , ASTNode(pos, arena) { }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
-  std::vector<std::shared_ptr<ASTNode>> values_;
+  std::vector<ASTNode*> values_;
 };
 
 
-class ASTDefineFun: public ASTNode, public std::enable_shared_from_this<ASTDefineFun> {
+class ASTDefineFun: public ASTNode {
 public:
   ASTDefineFun(
    int pos,
-   const std::string& line,
+   Arena* arena,
    const std::vector<std::string>& params,
-   std::vector<std::shared_ptr<ASTNode>>& body
+   std::vector<ASTNode*>& body
   )
     : params_(params)
     , body_(body)
-    , ASTNode(pos, line) { }
+    , ASTNode(pos, arena) { }
 
   const std::vector<std::string>& params() { return params_; }
-  std::vector<std::shared_ptr<ASTNode>>& body() { return body_; }
+  std::vector<ASTNode*>& body() { return body_; }
+
+  // the body's frame and the slot of each parameter in it (after resolve)
+  const FrameLayout* layout() const { return &layout_; }
+  const std::vector<int>& param_slots() const { return param_slots_; }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  // the compiled body (after compile)
+  const Code* code() const { return code_.get(); }
+  // native code for the body, if it's simple enough (after resolve)
+  JitFunction* jit() { return jit_.get(); }
+
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
   const std::vector<std::string> params_;
-  std::vector<std::shared_ptr<ASTNode>> body_;
+  std::vector<ASTNode*> body_;
+  FrameLayout layout_;
+  std::vector<int> param_slots_;
+  std::shared_ptr<Code> code_;
+  std::shared_ptr<JitFunction> jit_;
 };
 
 
-class ASTCallNamed: public ASTNode, public std::enable_shared_from_this<ASTCallNamed> {
+class ASTCallNamed: public ASTNode {
 public:
   ASTCallNamed(
     int pos,
-    const std::string& line,
+    Arena* arena,
     const std::string& name,
-    std::vector<std::shared_ptr<ASTNode>> args
+    std::vector<ASTNode*> args
   )
     : name_(name)
+    , address_(ADDRESS_FREE, -1, -1)
     , args_(args)
-    , ASTNode(pos, line) { }
+    , ASTNode(pos, arena) { }
 
   const std::string& name() const { return name_; }
+  const Address& address() const { return address_; }
+  const std::vector<ASTNode*>& args() const { return args_; }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
+  int add_call_site(Code& code);
+  bool compile_pipeline(Code& code);
+
   const std::string name_;
-  std::vector<std::shared_ptr<ASTNode>> args_;
+  Address address_;
+  std::vector<ASTNode*> args_;
 };
 
 
@@ -329,117 +988,501 @@ class ASTAssignment: public ASTNode {
 public:
   ASTAssignment(
     int pos,
-    const std::string& line,
+    Arena* arena,
     const std::string& name,
-    std::shared_ptr<ASTNode> value
+    ASTNode* value
   )
     : name_(name)
+    , address_(ADDRESS_FREE, -1, -1)
     , value_(value)
-    , ASTNode(pos, line) { }
+    , ASTNode(pos, arena) { }
 
   const std::string& name() const { return name_; }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
   const std::string name_;
-  std::shared_ptr<ASTNode> value_;
+  Address address_;
+  ASTNode* value_;
 };
 
 
 class ASTDelete: public ASTNode {
 public:
-  ASTDelete(int pos, const std::string& line, const std::string& name)
-    : name_(name), ASTNode(pos, line) { }
+  ASTDelete(int pos, Arena* arena, const std::string& name)
+    : name_(name), address_(ADDRESS_FREE, -1, -1), ASTNode(pos, arena) { }
 
   const std::string& name() const { return name_; }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
   const std::string name_;
+  Address address_;
 };
 
 
 class ASTIdentifier: public ASTNode {
 public:
-  ASTIdentifier(int pos, const std::string& line, const std::string& name)
-    : name_(name), ASTNode(pos, line) { }
+  ASTIdentifier(int pos, Arena* arena, const std::string& name)
+    : name_(name), address_(ADDRESS_FREE, -1, -1), ASTNode(pos, arena) { }
 
   const std::string& name() const { return name_; }
+  const Address& address() const { return address_; }
 
-  std::shared_ptr<Object> run(
-    std::shared_ptr<Scope> scope,
-    std::vector<std::shared_ptr<ASTNode>>& stack
+  Value run(
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
   ) override;
 
+  void resolve(Resolver& resolver) override;
+  void compile(Code& code) override;
+
 private:
   const std::string name_;
+  Address address_;
 };
 
 
-//// error handling (in parsing and while running code)
+//// Resolver: binding each name in the ASTNodes to an Address
 
 
-std::string error_arrow(int position);
-std::runtime_error error(int position, const std::string& message);
-std::runtime_error error(
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  const std::string& message
-);
+class Resolver {
+public:
+  // 'frame' is the function body's FrameLayout, or nullptr for code outside of any function
+  Resolver(FrameLayout* frame): frame_(frame) { }
 
+  // where a name that's read (or deleted) will be found
+  Address lookup(const std::string& name);
+  // where a name that's assigned will be put (adding a slot to the frame if need be)
+  Address bind(const std::string& name);
 
-//// parsing: turning the source code into ASTNodes
+private:
+  FrameLayout* frame_;
+};
 
 
-typedef std::pair<int, const std::string> PosToken;
+// resolves a statement that will run in the global Scope
+void resolve(ASTNode* statement);
 
 
-std::vector<PosToken> tokenize(const std::string& line);
+//// Code: ASTNodes compiled into a flat sequence of instructions
 
-std::shared_ptr<ASTNode>
-  parse(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_int(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_list(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_fun(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_call(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_assign(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_delete(int& i, const std::vector<PosToken>& tokens, const std::string& line);
-std::shared_ptr<ASTNode>
-  parse_id(int& i, const std::vector<PosToken>& tokens, const std::string& line);
 
+enum Opcode {
+  OP_LOAD_CONST,       // push constants[arg]
+  OP_LOAD_NAME,        // push the variable at addresses[arg]
+  OP_STORE_NAME,       // assign the top of the stack to addresses[arg] (and keep it)
+  OP_DELETE_NAME,      // delete addresses[arg] and push its old value
+  OP_BUILD_LIST,       // pop arg values and push them as a list
+  OP_MAKE_FUNCTION,    // push a user-defined function for functions[arg]
+  OP_LOAD_CALLEE,      // push the function to be called by calls[arg]
+  OP_CALL,             // pop the arguments and function of calls[arg], push the result
+  OP_CALL_PIPELINE,    // like OP_CALLs for each call in pipelines[arg], but fused if possible
+  OP_POP,              // discard the top of the stack
+  OP_RETURN,           // stop and return the top of the stack
+  NUM_OPCODES
+};
 
-//// error handling ////////////////////////////////////////////////////////
 
+struct Instruction {
+  Opcode op;
+  int arg;
+};
 
-std::string error_arrow(int position) {
-  return std::string("---") + std::string(position, '-') + std::string("^\n");
-}
 
+struct CallSite {
+  std::string name;
+  Address address;                 // of the function's name
+  int num_args;
+  ASTNode* node;   // for stack traces
+};
 
-std::runtime_error error(int position, const std::string& message) {
-  return std::runtime_error(error_arrow(position) + message);
-}
 
+// reduce(f, map(g, map(h, lst))) or map(f, map(g, lst)): calls that can run in one pass
+struct PipelineSite {
+  int outer_call;               // index in calls of the 'reduce' or outermost 'map'
+  std::vector<int> map_calls;   // indexes in calls of the inner 'map's, from the outside in
+  bool has_initial;             // whether 'reduce' has a third argument
 
-std::runtime_error error(
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  const std::string& message
-) {
-  std::string stack_trace;
-  for (int i = 0;  i < stack.size();  i++ ) {
+  // the outer function and its first argument, each map and its function, the list, and the initial value
+  int num_items() const { return 2 + 2 * map_calls.size() + 1 + (has_initial ? 1 : 0); }
+};
+
+
+class Code {
+public:
+  Code(): max_depth_(0), depth_(0) { }
+
+  const std::vector<Instruction>& instructions() const { return instructions_; }
+  const std::vector<Value>& constants() const { return constants_; }
+  const std::vector<Address>& addresses() const { return addresses_; }
+  const std::vector<ASTDefineFun*>& functions() const { return functions_; }
+  const std::vector<CallSite>& calls() const { return calls_; }
+  const std::vector<PipelineSite>& pipelines() const { return pipelines_; }
+  int max_depth() const { return max_depth_; }
+
+  // append an instruction that changes the stack depth by 'effect'
+  void emit(Opcode op, int arg, int effect);
+
+  int add_constant(Value constant);
+  int add_address(const Address& address);
+  int add_function(ASTDefineFun* function);
+  int add_call(const CallSite& call);
+  int add_pipeline(const PipelineSite& pipeline);
+
+private:
+  std::vector<Instruction> instructions_;
+  std::vector<Value> constants_;
+  std::vector<Address> addresses_;
+  std::vector<ASTDefineFun*> functions_;
+  std::vector<CallSite> calls_;
+  std::vector<PipelineSite> pipelines_;
+  int max_depth_;
+  int depth_;
+};
+
+
+std::shared_ptr<Code> compile(const std::vector<ASTNode*>& statements);
+
+Value run_code(
+  const Code& code,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+);
+
+
+
+//// JIT: compiling integer-only functions to machine code
+
+
+// x86-64 only, and only where pages can be mapped executable
+#if defined(__x86_64__) && HAVE_MMAP && !defined(BABY_PYTHON_NO_JIT)
+#define HAVE_JIT 1
+#else
+#define HAVE_JIT 0
+#endif
+
+const int JIT_THRESHOLD = 1000;   // calls with all-int arguments before a function is compiled
+const int MAX_JIT_PARAMS = 8;
+
+// turned off by --no-jit (and never used by the tree-walker)
+bool jit_enabled = HAVE_JIT;
+
+// the arguments are ints, in the order of the function's parameters
+typedef int (*NativeFunction)(const int* args);
+
+
+// a name that native code calls, which must still be the builtin 'add' or 'mul' when it runs
+struct JitCallee {
+  Address address;
+  bool is_mul;
+};
+
+
+// native code for a user-defined function whose body is a single expression of ints, its own
+// parameters, and calls to add and mul; everything else stays with the interpreter
+class JitFunction {
+public:
+  JitFunction(ASTDefineFun* fun): fun_(fun), int_calls_(0), native_(nullptr), failed_(false) { }
+
+  // tallies a call whose arguments were all ints, compiling the function once there are enough
+  void count_int_call();
+
+  // the native code, if it has been compiled and can be used for a call from 'scope' right now
+  NativeFunction native(Scope* scope, std::vector<ASTNode*>& stack);
+
+private:
+  bool compile();
+  bool emit(const ASTNode* node, std::vector<uint8_t>& machine_code);
+
+  ASTDefineFun* fun_;
+  std::atomic<int> int_calls_;
+  std::atomic<NativeFunction> native_;   // set (once) after callees_, so threads can read both
+  std::atomic<bool> failed_;
+  std::mutex mutex_;
+  std::vector<JitCallee> callees_;
+  bool has_calls_;
+  std::shared_ptr<void> memory_;
+};
+
+
+// the native code of 'function', if it is a user-defined function that has been compiled
+NativeFunction native_code(
+  ObjectFunction* function,
+  Scope* scope,
+  std::vector<ASTNode*>& stack
+);
+
+
+//// data files: loading arrays of numbers from disk
+
+
+struct LoadOptions {
+  bool use_mmap = HAVE_MMAP;   // map the file into memory, rather than reading it
+  bool populate = false;       // fault in all of the mapped pages up front
+  bool stream = false;         // read the file a window at a time, as it's used (ObjectListStream)
+  int64_t window_size = 1 << 20;   // items per window when streaming (4 MB)
+  int read_ahead = 4;              // windows read at once ahead of the one being used
+  bool use_io_uring = HAVE_IO_URING;
+};
+
+// the dtype named by a file's suffix (data.uint8), or int32 if it doesn't have one
+DType suffix_dtype(const std::string& file_name);
+
+std::shared_ptr<ObjectList> load_data(const std::string& file_name, DType dtype, const LoadOptions& options);
+
+// a NumPy .npy file, whose header gives its dtype and shape: arrays of more than one dimension
+// are lists of lists (rows), which share the file's items
+std::shared_ptr<ObjectList> load_npy(const std::string& file_name, const LoadOptions& options);
+
+// the data file for name=path (or name:dtype=path, in which case ":dtype" is removed from 'var_name')
+std::shared_ptr<ObjectList> load_variable(std::string& var_name, const std::string& file_name, const LoadOptions& options);
+
+
+//// Arrow: handing lists to and from other programs without copying them
+
+// (ArrowSchema and ArrowArray are defined in baby-python.h)
+
+// fills in 'schema' and 'array' (which the caller releases) with an integer array of 'list's
+// items: a data file's own type and memory, or an int32 copy of any other list of integers
+void export_arrow(const std::shared_ptr<ObjectList>& list, ArrowSchema* schema, ArrowArray* array);
+
+// a list of the items in an integer Arrow array without nulls, sharing its memory; takes both
+// structs (releasing 'schema' now and 'array' when the list and all slices of it are gone)
+std::shared_ptr<ObjectList> import_arrow(ArrowSchema* schema, ArrowArray* array);
+
+
+//// ThreadPool: running map and reduce on many cores
+
+
+class ThreadPool {
+public:
+  // the calling thread is one of the 'num_threads'
+  ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  int num_threads() const { return queues_.size(); }
+
+  // runs task(0) ... task(num_tasks - 1) and returns when they're all done (tasks must not throw)
+  void run(int num_tasks, const std::function<void(int)>& task);
+
+private:
+  // each thread starts with its own share of the tasks and steals from the others when it runs out
+  struct Queue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+  void work(int thread_index);
+  bool run_one(int thread_index);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  const std::function<void(int)>* task_;
+  std::atomic<int> remaining_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  int generation_;
+  bool stopping_;
+};
+
+
+// how many threads map and reduce may use (--threads=N, or threads(n, f) for one call)
+int num_threads = 1;
+
+// more threads than this per core (or than MIN_MAX_THREADS on small machines) would only add
+// overhead, and a huge number could exhaust the OS
+const int MAX_THREADS_PER_CORE = 4;
+const int MIN_MAX_THREADS = 64;
+
+// the most that num_threads may be
+int max_threads();
+
+// set on threads that are running a chunk; map and reduce within them don't split again
+thread_local bool in_parallel = false;
+
+typedef std::function<void(
+  int chunk,
+  int64_t start,
+  int64_t stop,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+)> ChunkBody;
+
+// how many pieces a loop over 'size' items should be split into (1 means don't use threads)
+int num_chunks(int64_t size);
+
+// runs body on each chunk of [0, size), in parallel if there's more than one; each parallel
+// chunk gets its own nested Scope and copy of the stack, and the first chunk to fail rethrows
+void run_chunks(
+  int num_chunks,
+  int64_t size,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  const ChunkBody& body
+);
+
+
+//// embedding: the interpreter as a library (compiled with -DBABY_PYTHON_LIBRARY, for baby-python.h)
+
+// a global Scope with the built-in functions in it
+std::shared_ptr<Scope> make_global_scope();
+
+// where a global variable named 'name' is
+Address global_address(const std::string& name);
+
+
+//// scripts: whole files parsed up front and then run, perhaps on several sets of data (-f or a pipe)
+
+
+// one line of a script, parsed (and compiled, for the bytecode VM) once however often it's run
+struct ScriptLine {
+  int number;                     // counting from 1
+  std::shared_ptr<Arena> arena;   // the line's text and ASTNodes
+  ASTNode* ast;
+  std::shared_ptr<Code> code;     // nullptr with --tree-walker
+};
+
+// one line parsed and compiled (a runtime_error if it has a syntax error), and run
+ScriptLine parse_script_line(const std::string& line, int number);
+Value run_script_line(const ScriptLine& line, const std::shared_ptr<Scope>& scope, std::vector<ASTNode*>& stack);
+
+// every line of 'source' but blank lines and '#' comments, stopping at 'exit' (a runtime_error
+// with all of the syntax errors, each with its line, if there are any)
+std::vector<ScriptLine> parse_script(const std::string& name, std::istream& source);
+
+// runs each line in 'scope' and prints its result, stopping at the first error (printed, with
+// its line) and returning false
+bool run_script(const std::vector<ScriptLine>& script, const std::string& name, const std::shared_ptr<Scope>& scope);
+
+// a result as the REPL prints it, cut short at MAX_REPR characters
+std::string line_repr(const Value& result);
+
+bool stdin_is_terminal();
+
+
+//// statistics: where the time and memory of each line go (--stats)
+
+
+bool show_stats = false;
+
+// counted by operator new when show_stats is on, in the executable only (a library's host
+// program has its own operator new)
+std::atomic<int64_t> num_allocations(0);
+std::atomic<int64_t> bytes_allocated(0);
+
+// the process's peak resident set size in bytes, or 0 where that isn't known
+int64_t peak_rss();
+
+// the seconds each phase of a line took (negative for phases it didn't have) and what it allocated
+class LineStats {
+public:
+  LineStats();
+
+  // seconds since the last lap, or since the LineStats was made
+  double lap();
+
+  // "(tokenize ..., run ... seconds; N allocations, X MB; peak RSS Y MB)", allocations up to now
+  std::string report() const;
+
+  double tokenize = -1.0;
+  double parse = -1.0;
+  double compile = -1.0;
+  double run = -1.0;
+  double repr = -1.0;
+
+private:
+  std::chrono::high_resolution_clock::time_point last_;
+  int64_t allocations_;   // when the LineStats was made
+  int64_t bytes_;
+};
+
+
+//// error handling (in parsing and while running code)
+
+
+std::string error_arrow(int position);
+std::runtime_error error(int position, const std::string& message);
+std::runtime_error error(
+  std::vector<ASTNode*>& stack,
+  const std::string& message
+);
+
+
+//// parsing: turning the source code into ASTNodes
+
+
+enum TokenKind { TOKEN_NUMBER, TOKEN_NAME, TOKEN_PUNCTUATION };
+
+struct PosToken {
+  int pos;             // where the token starts in the line
+  TokenKind kind;
+  std::string text;
+  int value;           // if it's a TOKEN_NUMBER
+};
+
+
+std::vector<PosToken> tokenize(const std::string& line);
+
+// a whole line as one resolved ASTNode in 'arena' (a runtime_error if it has a syntax error,
+// including tokens left over after a complete expression)
+ASTNode* parse_line(const std::vector<PosToken>& tokens, Arena& arena);
+
+// tokens[i], or a syntax error at the last token if the line ends before it
+const PosToken& token_at(int i, const std::vector<PosToken>& tokens);
+
+ASTNode*
+  parse(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_int(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_list(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_fun(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_call(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_assign(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_delete(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+ASTNode*
+  parse_id(int& i, const std::vector<PosToken>& tokens, Arena& arena);
+
+
+//// error handling ////////////////////////////////////////////////////////
+
+
+std::string error_arrow(int position) {
+  return std::string("---") + std::string(position, '-') + std::string("^\n");
+}
+
+
+std::runtime_error error(int position, const std::string& message) {
+  return std::runtime_error(error_arrow(position) + message);
+}
+
+
+std::runtime_error error(
+  std::vector<ASTNode*>& stack,
+  const std::string& message
+) {
+  std::string stack_trace;
+  for (int i = 0;  i < stack.size();  i++ ) {
     if (i != 0) {
       stack_trace += "   " + stack[i]->line() + "\n";
     }
@@ -452,240 +1495,293 @@ std::runtime_error error(
 //// parsing ///////////////////////////////////////////////////////////////
 
 
-std::vector<PosToken> tokenize(const std::string& line) {
-  std::regex whitespaces("\\s*");
-  std::regex token_regex("(-?[0-9]+|[A-Za-z_][A-Za-z_0-9]*|\\(|\\)|\\[|\\]|,|;|\\{|\\}|=)");
-  auto tokens_begin = std::sregex_iterator(line.begin(), line.end(), token_regex);
-  auto tokens_end = std::sregex_iterator();
+bool is_space(char c) {
+  return c == ' '  ||  c == '\t'  ||  c == '\n'  ||  c == '\r'  ||  c == '\v'  ||  c == '\f';
+}
+
+
+bool is_digit(char c) {
+  return c >= '0'  &&  c <= '9';
+}
+
 
-  int previous = 0;
+bool is_name_start(char c) {
+  return (c >= 'A'  &&  c <= 'Z')  ||  (c >= 'a'  &&  c <= 'z')  ||  c == '_';
+}
+
+
+std::vector<PosToken> tokenize(const std::string& line) {
   std::vector<PosToken> out;
+  const char* text = line.data();
+  int size = line.size();
+  int pos = 0;
+
+  while (true) {
+    while (pos < size  &&  is_space(text[pos])) {
+      pos++;
+    }
+    if (pos == size) {
+      return out;
+    }
+
+    PosToken token;
+    token.pos = pos;
+    token.value = 0;
+    char c = text[pos];
+
+    if (is_digit(c)  ||  (c == '-'  &&  pos + 1 < size  &&  is_digit(text[pos + 1]))) {
+      // the value is worked out here, as the digits go by
+      bool negative = c == '-';
+      if (negative) {
+        pos++;
+      }
+      int64_t value = 0;
+      while (pos < size  &&  is_digit(text[pos])) {
+        value = 10 * value + (text[pos] - '0');
+        if (value > (int64_t)std::numeric_limits<int>::max() + (negative ? 1 : 0)) {
+          throw error(token.pos, "integer is too large");
+        }
+        pos++;
+      }
+      token.kind = TOKEN_NUMBER;
+      token.value = negative ? -value : value;
+    }
+
+    else if (is_name_start(c)) {
+      while (pos < size  &&  (is_name_start(text[pos])  ||  is_digit(text[pos]))) {
+        pos++;
+      }
+      token.kind = TOKEN_NAME;
+    }
+
+    else if (c == '('  ||  c == ')'  ||  c == '['  ||  c == ']'  ||  c == ','  ||
+             c == ';'  ||  c == '{'  ||  c == '}'  ||  c == '=') {
+      pos++;
+      token.kind = TOKEN_PUNCTUATION;
+    }
 
-  for (auto token_iter = tokens_begin;  token_iter != tokens_end;  ++token_iter) {
-    // text between tokens must be only whitespace
-    std::string between = line.substr(previous, token_iter->position() - previous);
-    if (!std::regex_match(between, whitespaces)) {
-      throw error(previous, "unexpected characters");
+    else {
+      throw error(pos, "unexpected characters");
     }
-    previous = token_iter->position() + token_iter->length();
 
-    // collect tokens
-    out.push_back(PosToken(token_iter->position(), token_iter->str()));
+    token.text.assign(text + token.pos, pos - token.pos);
+    out.push_back(std::move(token));
   }
-  return out;
 }
 
 
-std::shared_ptr<ASTNode>
-  parse(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
+const PosToken& token_at(int i, const std::vector<PosToken>& tokens) {
   if (i >= tokens.size()) {
-    throw error(0, "line ends without complete expression");
+    throw error(tokens.empty() ? 0 : tokens.back().pos, "unexpected end of line");
   }
+  return tokens[i];
+}
 
-  std::regex is_number("-?[0-9]+");
-  std::regex is_name("[A-Za-z_][A-Za-z_0-9]*");
 
-  if (tokens[i].second == "[") {
-    return parse_list(i, tokens, line);
+ASTNode*
+  parse(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  if (i >= tokens.size()) {
+    throw error(tokens.empty() ? 0 : tokens.back().pos, "line ends without complete expression");
+  }
+
+  if (tokens[i].text == "[") {
+    return parse_list(i, tokens, arena);
   }
 
-  else if (tokens[i].second == "def") {
-    return parse_fun(i, tokens, line);
+  else if (tokens[i].text == "def") {
+    return parse_fun(i, tokens, arena);
   }
 
-  else if (tokens[i].second == "del") {
-    return parse_delete(i, tokens, line);
+  else if (tokens[i].text == "del") {
+    return parse_delete(i, tokens, arena);
   }
 
-  else if (std::regex_match(tokens[i].second, is_number)) {
-    return parse_int(i, tokens, line);
+  else if (tokens[i].kind == TOKEN_NUMBER) {
+    return parse_int(i, tokens, arena);
   }
 
-  else if (std::regex_match(tokens[i].second, is_name)) {
-    if (i + 1 < tokens.size()  &&  tokens[i + 1].second == "=") {
-      return parse_assign(i, tokens, line);
+  else if (tokens[i].kind == TOKEN_NAME) {
+    if (i + 1 < tokens.size()  &&  tokens[i + 1].text == "=") {
+      return parse_assign(i, tokens, arena);
     }
 
-    else if (i + 1 < tokens.size()  &&  tokens[i + 1].second == "(") {
-      return parse_call(i, tokens, line);
+    else if (i + 1 < tokens.size()  &&  tokens[i + 1].text == "(") {
+      return parse_call(i, tokens, arena);
     }
 
     else {
-      return parse_id(i, tokens, line);
+      return parse_id(i, tokens, arena);
     }
   }
 
   else {
-    throw error(tokens[i].first, "unrecognized syntax");
+    throw error(tokens[i].pos, "unrecognized syntax");
   }
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_int(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
-  int value = std::stoi(tokens[i].second);
+ASTNode*
+  parse_int(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
+  int value = tokens[i].value;
 
   i++;  // get past int
 
-  return std::make_shared<ASTLiteralInt>(pos, line, value);
+  return arena.make<ASTLiteralInt>(pos, &arena, value);
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_list(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
+ASTNode*
+  parse_list(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
 
   i++;   // get past "["
 
-  std::vector<std::shared_ptr<ASTNode>> values;
+  std::vector<ASTNode*> values;
 
   bool first = true;
-  while (tokens[i].second != "]") {
+  while (token_at(i, tokens).text != "]") {
     if (!first) {
-      if (tokens[i].second != ",") {
-        throw error(tokens[i].first, "commas are required between list items");
+      if (token_at(i, tokens).text != ",") {
+        throw error(tokens[i].pos, "commas are required between list items");
       }
       i++;  // get past ","
     }
     first = false;
 
-    values.push_back(parse(i, tokens, line));
+    values.push_back(parse(i, tokens, arena));
   }
 
   i++;   // get past "]"
 
-  return std::make_shared<ASTLiteralList>(pos, line, values);
+  return arena.make<ASTLiteralList>(pos, &arena, values);
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_fun(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
+ASTNode*
+  parse_fun(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
 
   i++;  // get past "def"
 
-  if (tokens[i].second != "(") {
-    throw error(tokens[i].first, "'fun' must be followed by a list of function parameters");
+  if (token_at(i, tokens).text != "(") {
+    throw error(tokens[i].pos, "'fun' must be followed by a list of function parameters");
   }
 
   i++;  // get past "("
 
-  std::regex is_name("[A-Za-z_][A-Za-z_0-9]*");
   std::vector<std::string> params;
 
   bool first = true;
-  while (tokens[i].second != ")") {
+  while (token_at(i, tokens).text != ")") {
     if (!first) {
-      if (tokens[i].second != ",") {
-        throw error(tokens[i].first, "commas are required between function parameter names");
+      if (token_at(i, tokens).text != ",") {
+        throw error(tokens[i].pos, "commas are required between function parameter names");
       }
       i++;  // get past ","
     }
     first = false;
 
-    if (std::regex_match(tokens[i].second, is_name)) {
-      params.push_back(tokens[i].second);
+    if (token_at(i, tokens).kind == TOKEN_NAME) {
+      params.push_back(tokens[i].text);
     }
     else {
-      throw error(tokens[i].first, "function parameters must be identifiers");
+      throw error(tokens[i].pos, "function parameters must be identifiers");
     }
     i++;  // get past parameter name
   }
 
   i++;  // get past ")"
 
-  std::vector<std::shared_ptr<ASTNode>> body;
+  std::vector<ASTNode*> body;
 
-  if (tokens[i].second == "{") {
+  if (token_at(i, tokens).text == "{") {
     // curly brackets; accept statements separated by semicolons
 
     i++;  // get past "{"
 
     bool first = true;
-    while (tokens[i].second != "}") {
+    while (token_at(i, tokens).text != "}") {
       if (!first) {
-        if (tokens[i].second != ";") {
-          throw error(tokens[i].first, "semicolons are required between statements");
+        if (token_at(i, tokens).text != ";") {
+          throw error(tokens[i].pos, "semicolons are required between statements");
         }
         i++;  // get past ";"
       }
       first = false;
 
-      body.push_back(parse(i, tokens, line));
+      body.push_back(parse(i, tokens, arena));
     }
 
     i++;   // get past "}"
   }
   else {
     // no curly brackets; only one statement
-    body.push_back(parse(i, tokens, line));
+    body.push_back(parse(i, tokens, arena));
   }
 
-  return std::make_shared<ASTDefineFun>(pos, line, params, body);
+  return arena.make<ASTDefineFun>(pos, &arena, params, body);
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_call(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
-  const std::string name = tokens[i].second;
+ASTNode*
+  parse_call(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
+  const std::string name = tokens[i].text;
 
   i++;  // get past name
   i++;  // get past "("
 
-  std::vector<std::shared_ptr<ASTNode>> args;
+  std::vector<ASTNode*> args;
 
   bool first = true;
-  while (tokens[i].second != ")") {
+  while (token_at(i, tokens).text != ")") {
     if (!first) {
-      if (tokens[i].second != ",") {
-        throw error(tokens[i].first, "commas are required between list items");
+      if (token_at(i, tokens).text != ",") {
+        throw error(tokens[i].pos, "commas are required between list items");
       }
       i++;  // get past ","
     }
     first = false;
 
-    args.push_back(parse(i, tokens, line));
+    args.push_back(parse(i, tokens, arena));
   }
 
   i++;   // get past ")"
 
-  return std::make_shared<ASTCallNamed>(pos, line, name, args);
+  return arena.make<ASTCallNamed>(pos, &arena, name, args);
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_assign(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
-  const std::string name = tokens[i].second;
+ASTNode*
+  parse_assign(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
+  const std::string name = tokens[i].text;
 
   i++;  // get past name
   i++;  // get past "="
 
-  std::shared_ptr<ASTNode> value = parse(i, tokens, line);
+  ASTNode* value = parse(i, tokens, arena);
 
-  return std::make_shared<ASTAssignment>(pos, line, name, value);
+  return arena.make<ASTAssignment>(pos, &arena, name, value);
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_delete(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
+ASTNode*
+  parse_delete(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
 
   i++;  // get past "del"
 
-  if (i >= tokens.size()  ||  tokens[i].second != "(") {
+  if (i >= tokens.size()  ||  tokens[i].text != "(") {
     throw error(pos, "'del' must be followed by a name in parentheses");
   }
 
   i++;  // get past "("
 
-  std::regex is_name("[A-Za-z_][A-Za-z_0-9]*");
-
   std::string name;
-  if (i < tokens.size()  &&  std::regex_match(tokens[i].second, is_name)) {
-    name = tokens[i].second;
+  if (i < tokens.size()  &&  tokens[i].kind == TOKEN_NAME) {
+    name = tokens[i].text;
   }
   else {
     throw error(pos, "name of variable to delete must be provided");
@@ -693,536 +1789,4293 @@ std::shared_ptr<ASTNode>
 
   i++;  // get past name
 
-  if (i >= tokens.size()  ||  tokens[i].second != ")") {
+  if (i >= tokens.size()  ||  tokens[i].text != ")") {
     throw error(pos, "parentheses must be closed after name of variable to delete");
   }
 
   i++;  // get past ")"
 
-  return std::make_shared<ASTDelete>(pos, line, name);
+  return arena.make<ASTDelete>(pos, &arena, name);
 }
 
 
-std::shared_ptr<ASTNode>
-  parse_id(int& i, const std::vector<PosToken>& tokens, const std::string& line) {
-  int pos = tokens[i].first;
-  const std::string name = tokens[i].second;
+ASTNode*
+  parse_id(int& i, const std::vector<PosToken>& tokens, Arena& arena) {
+  int pos = tokens[i].pos;
+  const std::string name = tokens[i].text;
 
   i++;  // get past name
 
-  return std::make_shared<ASTIdentifier>(pos, line, name);
+  return arena.make<ASTIdentifier>(pos, &arena, name);
 }
 
 
-//// Scope /////////////////////////////////////////////////////////////////
+ASTNode* parse_line(const std::vector<PosToken>& tokens, Arena& arena) {
+  int i = 0;
+  ASTNode* ast = parse(i, tokens, arena);
+  if (i < tokens.size()) {
+    // unused tokens after building a whole AST is an error
+    throw error(tokens[i].pos, "complete expression, but line doesn't end");
+  }
+  resolve(ast);
+  return ast;
+}
 
 
-void Scope::assign(
-  const std::string& name,
-  std::shared_ptr<Object> object,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  objects_[name] = object;
-}
+//// Symbols ///////////////////////////////////////////////////////////////
 
 
-std::shared_ptr<Object> Scope::del(
-  const std::string& name,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  if (objects_.count(name)) {
-    std::shared_ptr<Object> result = objects_[name];
-    objects_.erase(name);
-    return result;
-  }
-  else if (parent_) {
-    return parent_->del(name, stack);
-  }
-  else {
-    throw error(stack, "there is no variable named '" + name + "'");
+// only added to while parsing, so running code (on any thread) can read them freely
+std::unordered_map<std::string, int> symbol_ids;
+std::vector<std::string> symbol_names;
+std::vector<bool> symbols_in_frames;
+
+
+int intern(const std::string& name) {
+  std::unordered_map<std::string, int>::const_iterator found = symbol_ids.find(name);
+  if (found != symbol_ids.end()) {
+    return found->second;
   }
+  symbol_names.push_back(name);
+  symbol_ids[name] = symbol_names.size() - 1;
+  return symbol_names.size() - 1;
 }
 
 
-std::shared_ptr<Object> Scope::get(
-  const std::string& name,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  if (objects_.count(name)) {
-    return objects_[name];
-  }
-  else if (parent_) {
-    return parent_->get(name, stack);
-  }
-  else {
-    throw error(stack, "there is no variable named '" + name + "'");
-  }
+const std::string& symbol_name(int symbol) {
+  return symbol_names[symbol];
 }
 
 
-//// Objects ///////////////////////////////////////////////////////////////
+bool in_any_frame(int symbol) {
+  return symbol < symbols_in_frames.size()  &&  symbols_in_frames[symbol];
+}
 
 
-std::string ObjectInt::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
-  }
+//// Scope /////////////////////////////////////////////////////////////////
 
-  std::string out = std::to_string(value_);
 
-  remaining -= out.size();
+bool Scope::enter(const FrameLayout* layout) {
+  if (layout_ == layout) {
+    // the same function again (e.g. each item of a map shares one Scope)
+    return true;
+  }
+  else if (layout_ == nullptr  &&  parent_  &&  slots_.empty()) {
+    layout_ = layout;
+    slots_.resize(layout->symbols.size());
+    return true;
+  }
+  else {
+    return false;
+  }
+}
 
+
+std::shared_ptr<Scope> Scope::begin_frame(const std::shared_ptr<Scope>& self) {
+  if (!spare_) {
+    return std::make_shared<Scope>(self);
+  }
+  std::shared_ptr<Scope> out = std::move(spare_);
+  out->parent_ = self;
+  out->global_ = global_;
   return out;
 }
 
 
-std::string ObjectList::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
+void Scope::end_frame(std::shared_ptr<Scope>& frame) {
+  // not if something else still refers to it
+  if (frame.use_count() != 1) {
+    return;
   }
+  frame->parent_.reset();
+  frame->layout_ = nullptr;
+  frame->slots_.clear();   // keeps its capacity
+  spare_ = std::move(frame);
+}
 
-  remaining--;
-
-  std::string out = "[";
-  for (int i = 0;  i < values_.size();  i++) {
-    if (i != 0) {
-      out += ", ";
-      remaining -= 2;
-    }
-    out += values_[i]->repr(remaining);
 
-    if (remaining < 0) {
-      break;
+Value* Scope::find(int symbol) {
+  if (!parent_) {
+    if (symbol < slots_.size()  &&  slots_[symbol]) {
+      return &slots_[symbol];
     }
   }
-
-  if (remaining >= 0) {
-    out += "]";
+  else if (layout_) {
+    for (int i = 0;  i < slots_.size();  i++) {
+      if (layout_->symbols[i] == symbol  &&  slots_[i]) {
+        return &slots_[i];
+      }
+    }
   }
+  return nullptr;
+}
 
-  remaining--;
 
-  return out;
+void Scope::assign(
+  const Address& address,
+  Value object,
+  std::vector<ASTNode*>& stack
+) {
+  if (address.kind == ADDRESS_LOCAL) {
+    slots_[address.slot] = object;
+  }
+  else {
+    // resolve gives every name assigned in a function a slot, so the rest are global
+    if (address.symbol >= slots_.size()) {
+      slots_.resize(address.symbol + 1);
+    }
+    slots_[address.symbol] = object;
+  }
 }
 
 
-std::string ObjectFunctionAdd::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
+Value Scope::del(
+  const Address& address,
+  std::vector<ASTNode*>& stack
+) {
+  Value* found;
+  if (address.kind == ADDRESS_LOCAL) {
+    found = slots_[address.slot] ? &slots_[address.slot] : nullptr;
+  }
+  else {
+    found = find(address.symbol);
   }
 
-  remaining -= 24;
-
-  return "<builtin function 'add'>";
+  if (found) {
+    Value result = *found;
+    found->reset();
+    return result;
+  }
+  else if (parent_  &&  in_parallel) {
+    // other threads may be reading the outer Scopes
+    throw error(stack, "cannot delete '" + symbol_name(address.symbol) + "' from an outer scope while running on many threads");
+  }
+  else if (parent_) {
+    return parent_->del(Address(ADDRESS_FREE, address.symbol, -1), stack);
+  }
+  else {
+    throw error(stack, "there is no variable named '" + symbol_name(address.symbol) + "'");
+  }
 }
 
 
-std::shared_ptr<Object> ObjectFunctionAdd::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
+Value Scope::get(
+  const Address& address,
+  std::vector<ASTNode*>& stack
 ) {
-  if (args.size() != 2) {
-    throw error(stack, "'add' function takes exactly 2 arguments");
+  Value* found = locate(address);
+  if (!found) {
+    throw error(stack, "there is no variable named '" + symbol_name(address.symbol) + "'");
   }
+  return *found;
+}
 
-  std::shared_ptr<ObjectInt> arg0_int = std::dynamic_pointer_cast<ObjectInt>(args[0]);
-  std::shared_ptr<ObjectInt> arg1_int = std::dynamic_pointer_cast<ObjectInt>(args[1]);
 
-  std::shared_ptr<ObjectList> arg0_list = std::dynamic_pointer_cast<ObjectList>(args[0]);
-  std::shared_ptr<ObjectList> arg1_list = std::dynamic_pointer_cast<ObjectList>(args[1]);
+Value* Scope::locate(const Address& address) {
+  Scope* scope = this;
 
-  if (arg0_int  &&  arg1_int) {
-    return std::make_shared<ObjectInt>(arg0_int->value() + arg1_int->value());
+  if (address.kind == ADDRESS_LOCAL) {
+    if (slots_[address.slot]) {
+      return &slots_[address.slot];
+    }
+    // deleted or not yet assigned: look for it in the caller's variables
+    scope = parent_.get();
   }
 
-  else if (arg0_list  &&  arg1_list) {
-    std::vector<std::shared_ptr<Object>> values;
-    for (int i = 0;  i < arg0_list->values().size();  i++) {
-      values.push_back(arg0_list->values()[i]);
-    }
-    for (int i = 0;  i < arg1_list->values().size();  i++) {
-      values.push_back(arg1_list->values()[i]);
+  else if (address.kind == ADDRESS_GLOBAL) {
+    if (address.symbol < slots_.size()  &&  slots_[address.symbol]) {
+      return &slots_[address.symbol];
     }
-    return std::make_shared<ObjectList>(values);
+    scope = nullptr;
   }
 
-  else {
-    throw error(stack, "'add' function's arguments must both be integers or both be lists");
+  for (;  scope != nullptr;  scope = scope->parent_.get()) {
+    Value* found = scope->find(address.symbol);
+    if (found) {
+      return found;
+    }
   }
+
+  return nullptr;
 }
 
 
-std::string ObjectFunctionMul::repr(int& remaining) const {
+Value* Scope::locate_callee(const Address& address) {
+  // functions are almost always called by global names like 'add' and 'map', which no frame
+  // along the way can have, so they don't have to be searched for
+  if (address.kind == ADDRESS_FREE  &&  !in_any_frame(address.symbol)) {
+    return global_->find(address.symbol);
+  }
+  return locate(address);
+}
+
+
+//// parallel //////////////////////////////////////////////////////////////
+
+
+std::unique_ptr<ThreadPool> thread_pool;
+
+
+ThreadPool::ThreadPool(int num_threads)
+  : task_(nullptr), remaining_(0), generation_(0), stopping_(false) {
+  for (int i = 0;  i < num_threads;  i++) {
+    queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+  }
+  // thread 0 is whichever thread calls run
+  for (int i = 1;  i < num_threads;  i++) {
+    threads_.push_back(std::thread(&ThreadPool::work, this, i));
+  }
+}
+
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (int i = 0;  i < threads_.size();  i++) {
+    threads_[i].join();
+  }
+}
+
+
+void ThreadPool::run(int num_tasks, const std::function<void(int)>& task) {
+  task_ = &task;
+  remaining_ = num_tasks;
+
+  // deal out contiguous blocks of tasks, so that neighboring chunks stay on one thread
+  for (int i = 0;  i < num_threads();  i++) {
+    std::lock_guard<std::mutex> lock(queues_[i]->mutex);
+    for (int j = i * num_tasks / num_threads();  j < (i + 1) * num_tasks / num_threads();  j++) {
+      queues_[i]->tasks.push_back(j);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+  }
+  wake_.notify_all();
+
+  while (run_one(0)) { }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return remaining_ == 0; });
+}
+
+
+void ThreadPool::work(int thread_index) {
+  int seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, seen] { return stopping_  ||  generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+    }
+
+    while (run_one(thread_index)) { }
+  }
+}
+
+
+bool ThreadPool::run_one(int thread_index) {
+  int task = -1;
+
+  // take from the front of our own queue, or steal from the back of someone else's
+  for (int i = 0;  i < num_threads()  &&  task == -1;  i++) {
+    Queue& queue = *queues_[(thread_index + i) % num_threads()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      if (i == 0) {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+      }
+      else {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+      }
+    }
+  }
+
+  if (task == -1) {
+    return false;
+  }
+
+  in_parallel = true;
+  (*task_)(task);
+  in_parallel = false;
+
+  if (--remaining_ == 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_.notify_all();
+  }
+  return true;
+}
+
+
+int max_threads() {
+  return std::max(MIN_MAX_THREADS, MAX_THREADS_PER_CORE * (int)std::thread::hardware_concurrency());
+}
+
+
+int num_chunks(int64_t size) {
+  if (num_threads <= 1  ||  in_parallel) {
+    return 1;
+  }
+
+  // a few chunks per thread, so that threads that finish early can steal from the others
+  int64_t chunks = 4 * num_threads;
+  if (size / chunks < MIN_CHUNK_SIZE) {
+    chunks = size / MIN_CHUNK_SIZE;
+  }
+  return chunks < 1 ? 1 : chunks;
+}
+
+
+void run_chunks(
+  int num_chunks,
+  int64_t size,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  const ChunkBody& body
+) {
+  if (num_chunks == 1) {
+    body(0, 0, size, scope, stack);
+    return;
+  }
+
+  if (!thread_pool  ||  thread_pool->num_threads() != num_threads) {
+    thread_pool.reset();
+    thread_pool.reset(new ThreadPool(num_threads));
+  }
+
+  std::vector<std::exception_ptr> errors(num_chunks);
+
+  thread_pool->run(num_chunks, [&](int chunk) {
+    // functions assign their parameters in the Scope they're given, so each chunk needs its own
+    std::shared_ptr<Scope> chunk_scope = std::make_shared<Scope>(scope);
+    std::vector<ASTNode*> chunk_stack(stack);
+    try {
+      body(chunk, chunk * size / num_chunks, (chunk + 1) * size / num_chunks, chunk_scope, chunk_stack);
+    }
+    catch (...) {
+      errors[chunk] = std::current_exception();
+    }
+  });
+
+  // the earliest chunk's error is the one that a single thread would have hit first
+  for (int chunk = 0;  chunk < num_chunks;  chunk++) {
+    if (errors[chunk]) {
+      std::rethrow_exception(errors[chunk]);
+    }
+  }
+}
+
+
+//// kernels ///////////////////////////////////////////////////////////////
+
+
+// simple loops, which the compiler vectorizes (unsigned, so that wrapping around is well-defined)
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(BABY_PYTHON_NO_KERNEL_DISPATCH)
+#define KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define KERNEL
+#endif
+
+
+KERNEL int32_t sum_int32(const int32_t* data, int64_t size) {
+  uint32_t total = 0;
+  for (int64_t i = 0;  i < size;  i++) {
+    total += (uint32_t)data[i];
+  }
+  return (int32_t)total;
+}
+
+
+KERNEL int32_t product_int32(const int32_t* data, int64_t size) {
+  uint32_t total = 1;
+  for (int64_t i = 0;  i < size;  i++) {
+    total *= (uint32_t)data[i];
+  }
+  return (int32_t)total;
+}
+
+
+KERNEL void add_scalar_int32(const int32_t* data, int64_t size, int32_t scalar, int32_t* out) {
+  for (int64_t i = 0;  i < size;  i++) {
+    out[i] = (int32_t)((uint32_t)data[i] + (uint32_t)scalar);
+  }
+}
+
+
+KERNEL void mul_scalar_int32(const int32_t* data, int64_t size, int32_t scalar, int32_t* out) {
+  for (int64_t i = 0;  i < size;  i++) {
+    out[i] = (int32_t)((uint32_t)data[i] * (uint32_t)scalar);
+  }
+}
+
+
+KERNEL void mul_int32(const int32_t* left, const int32_t* right, int64_t size, int32_t* out) {
+  for (int64_t i = 0;  i < size;  i++) {
+    out[i] = (int32_t)((uint32_t)left[i] * (uint32_t)right[i]);
+  }
+}
+
+
+#undef KERNEL
+
+
+template <typename T>
+void copy_array_items(const ObjectListArray<T>* array, int32_t* out) {
+  const T* data = array->data();
+  for (int64_t i = 0;  i < array->size();  i++) {
+    out[i] = item_int(data[i]);
+  }
+}
+
+
+// the items of 'list' as int32s, either where they already are or copied into 'copy'
+// (nullptr if any of them isn't an int)
+const int32_t* int32_items(const ObjectList* list, std::vector<int32_t>& copy) {
+  const ObjectListInt32* list_int32 = as_list_int32(list);
+  if (list_int32) {
+    return list_int32->data();
+  }
+  if (list->type() == OBJECT_LIST_STREAM) {
+    copy.resize(list->size());
+    static_cast<const ObjectListStream*>(list)->read(0, list->size(), copy.data());
+    return copy.data();
+  }
+  const ObjectListArrayBase* array = as_list_array(list);
+  if (array) {
+    copy.resize(list->size());
+    switch (array->dtype()) {
+#define CASE(DTYPE, T) case DTYPE: copy_array_items(static_cast<const ObjectListArray<T>*>(array), copy.data()); break;
+      FOR_EACH_ARRAY_DTYPE(CASE)
+#undef CASE
+      default: break;
+    }
+    return copy.data();
+  }
+  copy.reserve(list->size());
+  for (int64_t i = 0;  i < list->size();  i++) {
+    Value item = list->get(i);
+    if (!item.is_int()) {
+      return nullptr;
+    }
+    copy.push_back(item.to_int());
+  }
+  return copy.data();
+}
+
+
+// add or mul of a list and an int: the int is applied to every item
+Value broadcast(
+  const char* name,
+  void (*kernel)(const int32_t*, int64_t, int32_t, int32_t*),
+  const ObjectList* list,
+  int scalar,
+  std::vector<ASTNode*>& stack
+) {
+  std::vector<int32_t> copy;
+  const int32_t* data = int32_items(list, copy);
+  if (!data) {
+    throw error(stack, std::string("'") + name + "' function's list must contain only integers to be combined with an integer");
+  }
+  std::vector<int32_t> out(list->size());
+  kernel(data, list->size(), scalar, out.data());
+  return std::make_shared<ObjectListInt32>(std::move(out));
+}
+
+
+//// Objects ///////////////////////////////////////////////////////////////
+
+
+template <typename T>
+std::string repr_int(T value, int& remaining) {
+  if (remaining < 0) {
+    return "";
+  }
+
+  std::string out = std::to_string(value);
+
+  remaining -= out.size();
+
+  return out;
+}
+
+
+std::string Value::repr(int& remaining) const {
+  if (type_ == VALUE_INT) {
+    return repr_int(int_, remaining);
+  }
+  return object_->repr(remaining);
+}
+
+
+std::string ObjectList::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining--;
+
+  std::string out = "[";
+  for (int64_t i = 0;  i < size();  i++) {
+    if (i != 0) {
+      out += ", ";
+      remaining -= 2;
+    }
+    out += get(i).repr(remaining);
+
+    if (remaining < 0) {
+      break;
+    }
+  }
+
+  if (remaining >= 0) {
+    out += "]";
+  }
+
+  remaining--;
+
+  return out;
+}
+
+
+ObjectListInt32::ObjectListInt32(std::vector<int32_t>&& values): ObjectList(OBJECT_LIST_INT32) {
+  std::shared_ptr<std::vector<int32_t>> owned = std::make_shared<std::vector<int32_t>>(std::move(values));
+  data_ = owned->data();
+  size_ = owned->size();
+  storage_ = owned;
+}
+
+
+std::string ObjectListInt32::repr(int& remaining) const {
+  return repr_items(data_, size_, remaining);
+}
+
+
+template <typename T>
+std::string repr_items(const T* data, int64_t size, int& remaining) {
   if (remaining < 0) {
     return "";
   }
 
-  remaining -= 24;
-
-  return "<builtin function 'mul'>";
+  remaining--;
+
+  // same as ObjectList::repr, but without making a Value for each item
+  std::string out = "[";
+  for (int64_t i = 0;  i < size;  i++) {
+    if (i != 0) {
+      out += ", ";
+      remaining -= 2;
+    }
+    out += repr_int(data[i], remaining);
+
+    if (remaining < 0) {
+      break;
+    }
+  }
+
+  if (remaining >= 0) {
+    out += "]";
+  }
+
+  remaining--;
+
+  return out;
+}
+
+
+ObjectListRope::ObjectListRope(std::shared_ptr<ObjectList> left, std::shared_ptr<ObjectList> right)
+  : left_(left)
+  , right_(right)
+  , size_(left->size() + right->size())
+  , ObjectList(OBJECT_LIST_ROPE) {
+  const ObjectListRope* left_rope = left->type() == OBJECT_LIST_ROPE ? static_cast<const ObjectListRope*>(left.get()) : nullptr;
+  const ObjectListRope* right_rope = right->type() == OBJECT_LIST_ROPE ? static_cast<const ObjectListRope*>(right.get()) : nullptr;
+  height_ = 1 + std::max(left_rope ? left_rope->height_ : 0, right_rope ? right_rope->height_ : 0);
+}
+
+
+Value ObjectListRope::get(int64_t index) const {
+  const ObjectList* list = this;
+  while (list->type() == OBJECT_LIST_ROPE) {
+    const ObjectListRope* rope = static_cast<const ObjectListRope*>(list);
+    int64_t left_size = rope->left_->size();
+    if (index < left_size) {
+      list = rope->left_.get();
+    }
+    else {
+      index -= left_size;
+      list = rope->right_.get();
+    }
+  }
+  return list->get(index);
+}
+
+
+void for_each_piece(
+  const ObjectList* list,
+  int64_t start,
+  std::vector<ASTNode*>& stack,
+  const PieceBody& body
+) {
+  if (list->type() == OBJECT_LIST_ROPE) {
+    const ObjectListRope* rope = static_cast<const ObjectListRope*>(list);
+    int64_t left_size = rope->left()->size();
+    for_each_piece(rope->left().get(), start, stack, body);
+    for_each_piece(rope->right().get(), std::max(start - left_size, (int64_t)0), stack, body);
+  }
+  else if (list->type() == OBJECT_LIST_STREAM) {
+    static_cast<const ObjectListStream*>(list)->for_each_window(start, stack, body);
+  }
+  else if (start < list->size()) {
+    body(list, start);
+  }
+}
+
+
+// concatenating by copying: for short lists, or pieces of a rope too small to be worth a node
+std::shared_ptr<ObjectList> copy_concatenate(const ObjectList* left, const ObjectList* right) {
+  const ObjectListInt32* left_int32 = as_list_int32(left);
+  const ObjectListInt32* right_int32 = as_list_int32(right);
+
+  if (left_int32  &&  right_int32) {
+    // concatenating two unboxed lists makes an unboxed list
+    std::vector<int32_t> values;
+    values.reserve(left_int32->size() + right_int32->size());
+    values.insert(values.end(), left_int32->data(), left_int32->data() + left_int32->size());
+    values.insert(values.end(), right_int32->data(), right_int32->data() + right_int32->size());
+    return std::make_shared<ObjectListInt32>(std::move(values));
+  }
+
+  std::vector<Value> values;
+  values.reserve(left->size() + right->size());
+  for (int64_t i = 0;  i < left->size();  i++) {
+    values.push_back(left->get(i));
+  }
+  for (int64_t i = 0;  i < right->size();  i++) {
+    values.push_back(right->get(i));
+  }
+  return std::make_shared<ObjectListBoxed>(values);
+}
+
+
+int rope_height(const std::shared_ptr<ObjectList>& list) {
+  if (list->type() == OBJECT_LIST_ROPE) {
+    return static_cast<const ObjectListRope*>(list.get())->height();
+  }
+  return 0;
+}
+
+
+const ObjectListRope* as_rope(const std::shared_ptr<ObjectList>& list) {
+  return static_cast<const ObjectListRope*>(list.get());
+}
+
+
+std::shared_ptr<ObjectList> rope_node(
+  const std::shared_ptr<ObjectList>& left,
+  const std::shared_ptr<ObjectList>& right
+) {
+  if (left->size() + right->size() <= ROPE_LEAF_SIZE) {
+    return copy_concatenate(left.get(), right.get());
+  }
+  return std::make_shared<ObjectListRope>(left, right);
+}
+
+
+// node(a, node(b, c)) -> node(node(a, b), c)
+std::shared_ptr<ObjectList> rotate_left(const std::shared_ptr<ObjectList>& list) {
+  const ObjectListRope* rope = as_rope(list);
+  const ObjectListRope* right = as_rope(rope->right());
+  return rope_node(rope_node(rope->left(), right->left()), right->right());
+}
+
+
+// node(node(a, b), c) -> node(a, node(b, c))
+std::shared_ptr<ObjectList> rotate_right(const std::shared_ptr<ObjectList>& list) {
+  const ObjectListRope* rope = as_rope(list);
+  const ObjectListRope* left = as_rope(rope->left());
+  return rope_node(left->left(), rope_node(left->right(), rope->right()));
+}
+
+
+// concatenate where 'left' is more than one level taller: descend its right side
+std::shared_ptr<ObjectList> join_right(
+  const std::shared_ptr<ObjectList>& left,
+  const std::shared_ptr<ObjectList>& right
+) {
+  const ObjectListRope* rope = as_rope(left);
+  const std::shared_ptr<ObjectList>& outer = rope->left();
+  const std::shared_ptr<ObjectList>& inner = rope->right();
+
+  if (rope_height(inner) <= rope_height(right) + 1) {
+    std::shared_ptr<ObjectList> joined = rope_node(inner, right);
+    if (rope_height(joined) <= rope_height(outer) + 1) {
+      return rope_node(outer, joined);
+    }
+    return rotate_left(rope_node(outer, rotate_right(joined)));
+  }
+
+  std::shared_ptr<ObjectList> joined = join_right(inner, right);
+  std::shared_ptr<ObjectList> out = rope_node(outer, joined);
+  if (rope_height(joined) <= rope_height(outer) + 1) {
+    return out;
+  }
+  return rotate_left(out);
+}
+
+
+// the mirror image of join_right
+std::shared_ptr<ObjectList> join_left(
+  const std::shared_ptr<ObjectList>& left,
+  const std::shared_ptr<ObjectList>& right
+) {
+  const ObjectListRope* rope = as_rope(right);
+  const std::shared_ptr<ObjectList>& inner = rope->left();
+  const std::shared_ptr<ObjectList>& outer = rope->right();
+
+  if (rope_height(inner) <= rope_height(left) + 1) {
+    std::shared_ptr<ObjectList> joined = rope_node(left, inner);
+    if (rope_height(joined) <= rope_height(outer) + 1) {
+      return rope_node(joined, outer);
+    }
+    return rotate_right(rope_node(rotate_left(joined), outer));
+  }
+
+  std::shared_ptr<ObjectList> joined = join_left(left, inner);
+  std::shared_ptr<ObjectList> out = rope_node(joined, outer);
+  if (rope_height(joined) <= rope_height(outer) + 1) {
+    return out;
+  }
+  return rotate_right(out);
+}
+
+
+std::shared_ptr<ObjectList> concatenate(
+  const std::shared_ptr<ObjectList>& left,
+  const std::shared_ptr<ObjectList>& right
+) {
+  int left_height = rope_height(left);
+  int right_height = rope_height(right);
+
+  if (left_height > right_height + 1) {
+    return join_right(left, right);
+  }
+  else if (right_height > left_height + 1) {
+    return join_left(left, right);
+  }
+  else {
+    return rope_node(left, right);
+  }
+}
+
+
+std::shared_ptr<ObjectList> slice_list(
+  const std::shared_ptr<ObjectList>& list,
+  int64_t start,
+  int64_t stop,
+  int64_t step
+) {
+  int64_t size = (stop - start + step - 1) / step;
+
+  if (size == list->size()) {
+    return list;
+  }
+  else if (size == 0) {
+    // doesn't keep the original alive
+    return std::make_shared<ObjectListInt32>(std::vector<int32_t>());
+  }
+
+  switch (list->type()) {
+    case OBJECT_LIST_INT32:
+      if (step == 1) {
+        // a shorter span of the same array (of a memory-mapped file, perhaps)
+        const ObjectListInt32* list_int32 = static_cast<const ObjectListInt32*>(list.get());
+        return std::make_shared<ObjectListInt32>(list_int32->data() + start, size, list_int32->storage());
+      }
+      break;
+
+    case OBJECT_LIST_ARRAY:
+      if (step == 1) {
+        return static_cast<const ObjectListArrayBase*>(list.get())->slice(start, size);
+      }
+      break;
+
+    case OBJECT_LIST_ROPE:
+      if (step == 1) {
+        // only the pieces that overlap the slice are kept, and only the ones at the ends are cut
+        const ObjectListRope* rope = static_cast<const ObjectListRope*>(list.get());
+        int64_t left_size = rope->left()->size();
+        if (stop <= left_size) {
+          return slice_list(rope->left(), start, stop, 1);
+        }
+        else if (start >= left_size) {
+          return slice_list(rope->right(), start - left_size, stop - left_size, 1);
+        }
+        return concatenate(
+          slice_list(rope->left(), start, left_size, 1),
+          slice_list(rope->right(), 0, stop - left_size, 1)
+        );
+      }
+      break;
+
+    case OBJECT_LIST_STREAM:
+      if (step == 1) {
+        // a shorter span of the same file
+        const ObjectListStream* stream = static_cast<const ObjectListStream*>(list.get());
+        return std::make_shared<ObjectListStream>(
+          stream->file(), stream->offset() + start, size, stream->window_size()
+        );
+      }
+      break;
+
+    case OBJECT_LIST_RANGE: {
+      // a range of a range is another range
+      const ObjectListRange* range = static_cast<const ObjectListRange*>(list.get());
+      return std::make_shared<ObjectListRange>(range->item(start), range->step() * step, size);
+    }
+
+    case OBJECT_LIST_VIEW: {
+      // a view of a view is a view of the original
+      const ObjectListView* view = static_cast<const ObjectListView*>(list.get());
+      return std::make_shared<ObjectListView>(
+        view->parent(), view->start() + start * view->step(), view->step() * step, size
+      );
+    }
+
+    default:
+      break;
+  }
+
+  return std::make_shared<ObjectListView>(list, start, step, size);
+}
+
+
+void ListBuilder::append(Value item) {
+  if (!boxed_) {
+    if (item.is_int()) {
+      unboxed_.push_back(item.to_int());
+      return;
+    }
+
+    // first non-integer: switch to Values for everything collected so far
+    boxed_ = true;
+    values_.reserve(expected_size_);
+    for (int64_t i = 0;  i < unboxed_.size();  i++) {
+      values_.push_back(Value(unboxed_[i]));
+    }
+    unboxed_.clear();
+  }
+
+  values_.push_back(item);
+}
+
+
+void ListBuilder::extend(const ListBuilder& other) {
+  if (!boxed_  &&  !other.boxed_) {
+    unboxed_.insert(unboxed_.end(), other.unboxed_.begin(), other.unboxed_.end());
+  }
+  else if (!other.boxed_) {
+    for (int64_t i = 0;  i < other.unboxed_.size();  i++) {
+      values_.push_back(Value(other.unboxed_[i]));
+    }
+  }
+  else {
+    for (int64_t i = 0;  i < other.values_.size();  i++) {
+      append(other.values_[i]);
+    }
+  }
+}
+
+
+std::shared_ptr<ObjectList> ListBuilder::finish() {
+  if (boxed_) {
+    return std::make_shared<ObjectListBoxed>(values_);
+  }
+  return std::make_shared<ObjectListInt32>(std::move(unboxed_));
+}
+
+
+std::string ObjectFunctionAdd::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 24;
+
+  return "<builtin function 'add'>";
+}
+
+
+Value ObjectFunctionAdd::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 2) {
+    throw error(stack, "'add' function takes exactly 2 arguments");
+  }
+
+  ObjectList* arg0_list = as_list(args[0].object());
+  ObjectList* arg1_list = as_list(args[1].object());
+
+  if (args[0].is_int()  &&  args[1].is_int()) {
+    // wrapping around, as the JIT's and the vectorized loops' results do
+    return Value((int32_t)((uint32_t)args[0].to_int() + (uint32_t)args[1].to_int()));
+  }
+
+  else if (arg0_list  &&  arg1_list) {
+    return concatenate(
+      std::static_pointer_cast<ObjectList>(args[0].shared_object()),
+      std::static_pointer_cast<ObjectList>(args[1].shared_object())
+    );
+  }
+
+  else if (arg0_list  &&  args[1].is_int()) {
+    return broadcast("add", add_scalar_int32, arg0_list, args[1].to_int(), stack);
+  }
+
+  else if (args[0].is_int()  &&  arg1_list) {
+    return broadcast("add", add_scalar_int32, arg1_list, args[0].to_int(), stack);
+  }
+
+  else {
+    throw error(stack, "'add' function's arguments must be two integers, two lists (to concatenate), or a list and an integer");
+  }
+}
+
+
+std::string ObjectFunctionMul::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 24;
+
+  return "<builtin function 'mul'>";
+}
+
+
+Value ObjectFunctionMul::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 2) {
+    throw error(stack, "'mul' function takes exactly 2 arguments");
+  }
+
+  ObjectList* arg0_list = as_list(args[0].object());
+  ObjectList* arg1_list = as_list(args[1].object());
+
+  if (args[0].is_int()  &&  args[1].is_int()) {
+    return Value((int32_t)((uint32_t)args[0].to_int() * (uint32_t)args[1].to_int()));
+  }
+
+  else if (arg0_list  &&  arg1_list) {
+    // item by item
+    if (arg0_list->size() != arg1_list->size()) {
+      throw error(stack, "'mul' function's lists must have the same length");
+    }
+    std::vector<int32_t> copy0;
+    std::vector<int32_t> copy1;
+    const int32_t* data0 = int32_items(arg0_list, copy0);
+    const int32_t* data1 = int32_items(arg1_list, copy1);
+    if (!data0  ||  !data1) {
+      throw error(stack, "'mul' function's lists must contain only integers");
+    }
+    std::vector<int32_t> out(arg0_list->size());
+    mul_int32(data0, data1, arg0_list->size(), out.data());
+    return std::make_shared<ObjectListInt32>(std::move(out));
+  }
+
+  else if (arg0_list  &&  args[1].is_int()) {
+    return broadcast("mul", mul_scalar_int32, arg0_list, args[1].to_int(), stack);
+  }
+
+  else if (args[0].is_int()  &&  arg1_list) {
+    return broadcast("mul", mul_scalar_int32, arg1_list, args[0].to_int(), stack);
+  }
+
+  else {
+    throw error(stack, "'mul' function's arguments must be integers or lists of integers");
+  }
+}
+
+
+std::string ObjectFunctionGet::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 24;
+
+  return "<builtin function 'get'>";
+}
+
+
+Value ObjectFunctionGet::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 2) {
+    throw error(stack, "'get' function takes exactly 2 arguments");
+  }
+
+  ObjectList* arg0_list = as_list(args[0].object());
+
+  if (arg0_list  &&  args[1].is_int()) {
+    if (args[1].to_int() < 0  ||  args[1].to_int() >= arg0_list->size()) {
+      throw error(stack, "'get' function's index is out of range");
+    }
+    return arg0_list->get(args[1].to_int());
+  }
+
+  else {
+    throw error(stack, "'get' function's arguments must be a list (first) and an integer (second)");
+  }
+}
+
+
+std::string ObjectFunctionLen::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 24;
+
+  return "<builtin function 'len'>";
+}
+
+
+Value ObjectFunctionLen::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 1) {
+    throw error(stack, "'len' function takes exactly 1 argument");
+  }
+
+  ObjectList* arg0_list = as_list(args[0].object());
+
+  if (arg0_list) {
+    return Value((int)arg0_list->size());
+  }
+
+  else {
+    throw error(stack, "'len' function's argument must be a list");
+  }
+}
+
+
+std::string ObjectFunctionSlice::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 26;
+
+  return "<builtin function 'slice'>";
+}
+
+
+Value ObjectFunctionSlice::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 3  &&  args.size() != 4) {
+    throw error(stack, "'slice' function takes either 3 or 4 arguments");
+  }
+
+  ObjectList* arg0_list = as_list(args[0].object());
+  bool all_ints = args[1].is_int()  &&  args[2].is_int()  &&  (args.size() == 3  ||  args[3].is_int());
+
+  if (!arg0_list  ||  !all_ints) {
+    throw error(stack, "'slice' function's arguments must be a list (first) and integers (start, stop, and optional step)");
+  }
+
+  int64_t start = args[1].to_int();
+  int64_t stop = args[2].to_int();
+  int64_t step = args.size() == 4 ? args[3].to_int() : 1;
+
+  if (start < 0  ||  stop < 0) {
+    throw error(stack, "'slice' function's start and stop must not be negative");
+  }
+  if (step < 1) {
+    throw error(stack, "'slice' function's step must be positive");
+  }
+
+  // like Python, a range that goes past the end stops at the end
+  stop = std::min(stop, arg0_list->size());
+  start = std::min(start, stop);
+
+  return slice_list(std::static_pointer_cast<ObjectList>(args[0].shared_object()), start, stop, step);
+}
+
+
+std::string ObjectFunctionRange::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 26;
+
+  return "<builtin function 'range'>";
+}
+
+
+Value ObjectFunctionRange::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() < 1  ||  args.size() > 3) {
+    throw error(stack, "'range' function takes 1, 2, or 3 arguments");
+  }
+
+  for (int i = 0;  i < args.size();  i++) {
+    if (!args[i].is_int()) {
+      throw error(stack, "'range' function's arguments must be integers (stop, or start, stop, and optional step)");
+    }
+  }
+
+  // same as Python: range(stop), range(start, stop), or range(start, stop, step)
+  int64_t start = args.size() == 1 ? 0 : args[0].to_int();
+  int64_t stop = args.size() == 1 ? args[0].to_int() : args[1].to_int();
+  int64_t step = args.size() == 3 ? args[2].to_int() : 1;
+
+  if (step == 0) {
+    throw error(stack, "'range' function's step must not be zero");
+  }
+
+  int64_t size = step > 0 ? (stop - start + step - 1) / step : (start - stop - step - 1) / -step;
+  return std::make_shared<ObjectListRange>(start, step, std::max(size, (int64_t)0));
+}
+
+
+std::string ObjectFunctionMap::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 24;
+
+  return "<builtin function 'map'>";
+}
+
+
+Value ObjectFunctionMap::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 2) {
+    throw error(stack, "'map' function takes exactly 2 arguments");
+  }
+
+  ObjectFunction* arg0_function = as_function(args[0].object());
+  ObjectList* arg1_list = as_list(args[1].object());
+
+  if (arg0_function  &&  arg1_list) {
+    ListBuilder values(arg1_list->size());
+
+    for_each_piece(arg1_list, 0, stack, [&](const ObjectList* piece, int64_t piece_start) {
+      int64_t size = piece->size() - piece_start;
+      int chunks = num_chunks(size);
+      std::vector<ListBuilder> chunk_values(chunks, ListBuilder(size / chunks + 1));
+
+      run_chunks(chunks, size, scope, stack, [&](
+        int chunk,
+        int64_t start,
+        int64_t stop,
+        const std::shared_ptr<Scope>& scope,
+        std::vector<ASTNode*>& stack
+      ) {
+        // the function has no side effects once it's native code, so it stays valid to the end
+        NativeFunction native = nullptr;
+
+        for (int64_t i = piece_start + start;  i < piece_start + stop;  i++) {
+          Value item = piece->get(i);
+          if (native  &&  item.is_int()) {
+            int arg = item.to_int();
+            chunk_values[chunk].append(Value(native(&arg)));
+            continue;
+          }
+
+          Value result = arg0_function->run(scope, stack, Args(&item, 1));
+
+          chunk_values[chunk].append(result);
+
+          if (!native) {
+            native = native_code(arg0_function, scope.get(), stack);
+          }
+        }
+      });
+
+      for (int chunk = 0;  chunk < chunks;  chunk++) {
+        values.extend(chunk_values[chunk]);
+      }
+    });
+
+    return values.finish();
+  }
+
+  else {
+    throw error(stack, "'map' function's arguments must be a function (first) and a list (second)");
+  }
+}
+
+
+std::string ObjectFunctionReduce::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 21;
+
+  return "<builtin function 'reduce'>";
+}
+
+
+// the last step of a parallel reduce: f(initial, partial[0], partial[1], ...)
+Value combine_partial(
+  ObjectFunction* function,
+  Value initial,
+  std::vector<Value> partial,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  // pairs of neighbors, so the order of the items is preserved
+  while (partial.size() > 1) {
+    std::vector<Value> next;
+    for (int i = 0;  i < partial.size();  i += 2) {
+      if (i + 1 < partial.size()) {
+        next.push_back(function->run(scope, stack, Args(&partial[i], 2)));
+      }
+      else {
+        next.push_back(partial[i]);
+      }
+    }
+    partial = next;
+  }
+
+  Value fargs[2] = { initial, partial[0] };
+  return function->run(scope, stack, Args(fargs, 2));
+}
+
+
+// reduce(add or mul, array, initial) for items [start, size), wrapping around as int arithmetic does
+template <typename T>
+int reduce_array(const ObjectListArray<T>* array, int64_t start, bool add, int initial) {
+  const T* data = array->data() + start;
+  int64_t size = array->size() - start;
+  uint32_t result = initial;
+  if (add) {
+    for (int64_t i = 0;  i < size;  i++) {
+      result += (uint32_t)item_int(data[i]);
+    }
+  }
+  else {
+    for (int64_t i = 0;  i < size;  i++) {
+      result *= (uint32_t)item_int(data[i]);
+    }
+  }
+  return (int32_t)result;
+}
+
+
+// reduce(f, lst, initial) for items [start, size) of lst, after 'initial'
+Value reduce_range(
+  ObjectFunction* function,
+  const ObjectList* list,
+  int64_t start,
+  Value initial,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  // a rope or stream is reduced one piece at a time, each starting from the previous piece's result
+  if (list->type() == OBJECT_LIST_ROPE  ||  list->type() == OBJECT_LIST_STREAM) {
+    Value result = initial;
+    for_each_piece(list, start, stack, [&](const ObjectList* piece, int64_t piece_start) {
+      result = reduce_range(function, piece, piece_start, result, scope, stack);
+    });
+    return result;
+  }
+
+  int64_t size = list->size() - start;
+
+  // reduce(add or mul, ...) of int32s is a sum or product, which needs no function calls
+  const ObjectListInt32* list_int32 = as_list_int32(list);
+  if (list_int32  &&  initial.is_int()) {
+    const int32_t* data = list_int32->data() + start;
+    if (has_type(function, OBJECT_FUNCTION_ADD)) {
+      return Value((int32_t)((uint32_t)initial.to_int() + (uint32_t)sum_int32(data, size)));
+    }
+    else if (has_type(function, OBJECT_FUNCTION_MUL)) {
+      return Value((int32_t)((uint32_t)initial.to_int() * (uint32_t)product_int32(data, size)));
+    }
+  }
+
+  // and for the other integer dtypes, with a loop specialized for each
+  const ObjectListArrayBase* array = as_list_array(list);
+  bool add = has_type(function, OBJECT_FUNCTION_ADD);
+  if (array  &&  initial.is_int()  &&  (add  ||  has_type(function, OBJECT_FUNCTION_MUL))) {
+    switch (array->dtype()) {
+#define CASE(DTYPE, T) case DTYPE: return Value(reduce_array(static_cast<const ObjectListArray<T>*>(array), start, add, initial.to_int()));
+      FOR_EACH_ARRAY_DTYPE(CASE)
+#undef CASE
+      default: break;
+    }
+  }
+
+  // and for ranges, which are never stored
+  const ObjectListRange* range = list->type() == OBJECT_LIST_RANGE ? static_cast<const ObjectListRange*>(list) : nullptr;
+  if (range  &&  initial.is_int()) {
+    uint32_t result = initial.to_int();
+    if (has_type(function, OBJECT_FUNCTION_ADD)) {
+      for (int64_t i = 0;  i < size;  i++) {
+        result += (uint32_t)range->item(start + i);
+      }
+      return Value((int32_t)result);
+    }
+    else if (has_type(function, OBJECT_FUNCTION_MUL)) {
+      for (int64_t i = 0;  i < size;  i++) {
+        result *= (uint32_t)range->item(start + i);
+      }
+      return Value((int32_t)result);
+    }
+  }
+
+  // likewise for every step'th int32 of a slice (not vectorized, but no Values)
+  const ObjectListView* view = list->type() == OBJECT_LIST_VIEW ? static_cast<const ObjectListView*>(list) : nullptr;
+  const ObjectListInt32* parent_int32 = view ? as_list_int32(view->parent().get()) : nullptr;
+  if (parent_int32  &&  initial.is_int()) {
+    const int32_t* data = parent_int32->data() + view->start() + start * view->step();
+    int64_t step = view->step();
+    uint32_t result = initial.to_int();
+    if (has_type(function, OBJECT_FUNCTION_ADD)) {
+      for (int64_t i = 0;  i < size;  i++) {
+        result += (uint32_t)data[i * step];
+      }
+      return Value((int32_t)result);
+    }
+    else if (has_type(function, OBJECT_FUNCTION_MUL)) {
+      for (int64_t i = 0;  i < size;  i++) {
+        result *= (uint32_t)data[i * step];
+      }
+      return Value((int32_t)result);
+    }
+  }
+
+  int chunks = function->associative() ? num_chunks(size) : 1;
+
+  if (chunks == 1) {
+    Value result = initial;
+    Value fargs[2];
+
+    for (int64_t i = start;  i < list->size();  i++) {
+      fargs[0] = std::move(result);
+      fargs[1] = list->get(i);
+
+      result = function->run(scope, stack, Args(fargs, 2));
+    }
+
+    return result;
+  }
+
+  // each chunk is reduced separately, then the partial results are combined as a tree
+  std::vector<Value> partial(chunks);
+
+  run_chunks(chunks, size, scope, stack, [&](
+    int chunk,
+    int64_t chunk_start,
+    int64_t chunk_stop,
+    const std::shared_ptr<Scope>& scope,
+    std::vector<ASTNode*>& stack
+  ) {
+    Value result = list->get(start + chunk_start);
+    Value fargs[2];
+
+    for (int64_t i = start + chunk_start + 1;  i < start + chunk_stop;  i++) {
+      fargs[0] = std::move(result);
+      fargs[1] = list->get(i);
+
+      result = function->run(scope, stack, Args(fargs, 2));
+    }
+
+    partial[chunk] = result;
+  });
+
+  return combine_partial(function, initial, partial, scope, stack);
+}
+
+
+Value ObjectFunctionReduce::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() == 2) {
+    ObjectFunction* arg0_function = as_function(args[0].object());
+    ObjectList* arg1_list = as_list(args[1].object());
+
+    if (!arg0_function  ||  !arg1_list) {
+      throw error(stack, "'reduce' function's arguments must be a function (first) and a list (second)");
+    }
+
+    if (arg1_list->size() == 0) {
+      throw error(stack, "'reduce' function's list argument can only be empty if a third argument (the initial value) is provided");
+    }
+
+    return reduce_range(arg0_function, arg1_list, 1, arg1_list->get(0), scope, stack);
+  }
+
+  else if (args.size() == 3) {
+    ObjectFunction* arg0_function = as_function(args[0].object());
+    ObjectList* arg1_list = as_list(args[1].object());
+
+    if (!arg0_function  ||  !arg1_list) {
+      throw error(stack, "'reduce' function's arguments must be a function (first) and a list (second)");
+    }
+
+    return reduce_range(arg0_function, arg1_list, 0, args[2], scope, stack);
+  }
+
+  else {
+    throw error(stack, "'reduce' function takes either 2 or 3 arguments");
+  }
+}
+
+
+std::string ObjectFunctionThreads::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 28;
+
+  return "<builtin function 'threads'>";
+}
+
+
+Value ObjectFunctionThreads::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != 2) {
+    throw error(stack, "'threads' function takes exactly 2 arguments");
+  }
+
+  ObjectFunction* arg1_function = as_function(args[1].object());
+
+  if (!args[0].is_int()  ||  !arg1_function  ||  args[0].to_int() < 1) {
+    throw error(stack, "'threads' function's arguments must be a positive integer (first) and a function of no arguments (second)");
+  }
+  if (args[0].to_int() > max_threads()) {
+    throw error(stack, "'threads' function's number of threads must be at most " + std::to_string(max_threads()));
+  }
+
+  if (in_parallel) {
+    // already running on one of the threads
+    return arg1_function->run(scope, stack, Args());
+  }
+
+  // only for the duration of this call, even if it fails
+  struct Restore {
+    int saved;
+    ~Restore() { num_threads = saved; }
+  } restore = { num_threads };
+
+  num_threads = args[0].to_int();
+  return arg1_function->run(scope, stack, Args());
+}
+
+
+std::string ObjectUserFunction::repr(int& remaining) const {
+  if (remaining < 0) {
+    return "";
+  }
+
+  remaining -= 23;
+
+  return "<user-defined function>";
+}
+
+
+Value ObjectUserFunction::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack,
+  Args args
+) {
+  if (args.size() != fun_->params().size()) {
+    throw error(stack, "wrong number of arguments for user-defined function");
+  }
+
+  if (jit_enabled  &&  eval_mode == EVAL_BYTECODE  &&  args.size() <= MAX_JIT_PARAMS) {
+    int ints[MAX_JIT_PARAMS];
+    bool all_ints = true;
+    for (int i = 0;  i < args.size()  &&  all_ints;  i++) {
+      all_ints = args[i].is_int();
+      ints[i] = args[i].to_int();
+    }
+    if (all_ints) {
+      NativeFunction native = fun_->jit()->native(scope.get(), stack);
+      if (native) {
+        return Value(native(ints));
+      }
+      fun_->jit()->count_int_call();
+    }
+  }
+
+  // the caller made a new Scope for this call, which becomes the function's frame
+  std::shared_ptr<Scope> fresh_scope;
+  if (!scope->enter(fun_->layout())) {
+    fresh_scope = std::make_shared<Scope>(scope);
+    fresh_scope->enter(fun_->layout());
+  }
+  const std::shared_ptr<Scope>& nested_scope = fresh_scope ? fresh_scope : scope;
+
+  for (int i = 0;  i < args.size();  i++) {
+    int slot = fun_->param_slots()[i];
+    nested_scope->assign(Address(ADDRESS_LOCAL, fun_->layout()->symbols[slot], slot), args[i], stack);
+  }
+
+  if (eval_mode == EVAL_BYTECODE) {
+    return run_code(*fun_->code(), nested_scope, stack);
+  }
+
+  Value out;
+  for (int i = 0;  i < fun_->body().size();  i++) {
+    out = fun_->body()[i]->run(nested_scope, stack);
+  }
+  return out;
+}
+
+
+//// ASTNodes //////////////////////////////////////////////////////////////
+
+
+const size_t Arena::BLOCK_SIZE;
+
+
+Arena::~Arena() {
+  // nodes only point to nodes made before them, so destroy in reverse
+  for (int i = nodes_.size() - 1;  i >= 0;  i--) {
+    nodes_[i]->~ASTNode();
+  }
+}
+
+
+void* Arena::allocate(size_t size) {
+  const size_t align = alignof(std::max_align_t);
+  size = (size + align - 1) / align * align;
+
+  if (used_ + size > BLOCK_SIZE) {
+    blocks_.push_back(std::unique_ptr<char[]>(new char[std::max(size, BLOCK_SIZE)]));
+    used_ = 0;
+  }
+
+  void* out = blocks_.back().get() + used_;
+  used_ += size;
+  return out;
+}
+
+
+Value ASTLiteralInt::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  return Value(value_);
+}
+
+
+Value ASTLiteralList::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  ListBuilder values(values_.size());
+
+  for (int i = 0;  i < values_.size();  i++) {
+    values.append(values_[i]->run(scope, stack));
+  }
+
+  return values.finish();
+}
+
+
+Value ASTDefineFun::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  return std::make_shared<ObjectUserFunction>(arena()->share(this));
+}
+
+
+Value ASTCallNamed::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  if (stack.size() == MAX_RECURSION) {
+    throw error(stack, "recursion is too deep (probably an infinite loop)");
+  }
+
+  Value maybe_fun = scope->get(address_, stack);
+
+  ObjectFunction* fun = as_function(maybe_fun.object());
+
+  if (!fun) {
+    throw error(stack, "attempting to call an object that is not a function");
+  }
+
+  // on the C++ stack, unless there are a lot of them
+  Value small_args[4];
+  std::vector<Value> large_args;
+  Value* values = small_args;
+  if (args_.size() > 4) {
+    large_args.resize(args_.size());
+    values = large_args.data();
+  }
+  for (int i = 0;  i < args_.size();  i++) {
+    values[i] = args_[i]->run(scope, stack);
+  }
+  Args args(values, args_.size());
+
+  stack.push_back(this);
+  Value result;
+  try {
+    if (fun->needs_frame()) {
+      std::shared_ptr<Scope> frame = scope->begin_frame(scope);
+      result = fun->run(frame, stack, args);
+      scope->end_frame(frame);
+    }
+    else {
+      result = fun->run(scope, stack, args);
+    }
+  }
+  catch (DataError const& exception) {
+    throw error(stack, exception.what());
+  }
+  stack.pop_back();
+
+  return result;
+}
+
+
+Value ASTAssignment::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  Value result = value_->run(scope, stack);
+
+  scope->assign(address_, result, stack);
+
+  return result;
+}
+
+
+Value ASTDelete::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  return scope->del(address_, stack);
+}
+
+
+Value ASTIdentifier::run(
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  return scope->get(address_, stack);
+}
+
+
+//// resolving /////////////////////////////////////////////////////////////
+
+
+Address Resolver::lookup(const std::string& name) {
+  int symbol = intern(name);
+  if (!frame_) {
+    return Address(ADDRESS_GLOBAL, symbol, -1);
+  }
+  for (int i = 0;  i < frame_->symbols.size();  i++) {
+    if (frame_->symbols[i] == symbol) {
+      return Address(ADDRESS_LOCAL, symbol, i);
+    }
+  }
+  // not (yet) a local variable; a later assignment in this body would still be found
+  return Address(ADDRESS_FREE, symbol, -1);
+}
+
+
+Address Resolver::bind(const std::string& name) {
+  Address address = lookup(name);
+  if (address.kind == ADDRESS_FREE) {
+    if (address.symbol >= symbols_in_frames.size()) {
+      symbols_in_frames.resize(address.symbol + 1);
+    }
+    symbols_in_frames[address.symbol] = true;
+    frame_->symbols.push_back(address.symbol);
+    return Address(ADDRESS_LOCAL, address.symbol, frame_->symbols.size() - 1);
+  }
+  return address;
+}
+
+
+void resolve(ASTNode* statement) {
+  Resolver resolver(nullptr);
+  statement->resolve(resolver);
+}
+
+
+void ASTLiteralInt::resolve(Resolver& resolver) { }
+
+
+void ASTLiteralList::resolve(Resolver& resolver) {
+  for (int i = 0;  i < values_.size();  i++) {
+    values_[i]->resolve(resolver);
+  }
+}
+
+
+void ASTDefineFun::resolve(Resolver& resolver) {
+  // the body runs in a frame of its own (a repeated parameter name gets one slot; the last wins)
+  Resolver body_resolver(&layout_);
+  for (int i = 0;  i < params_.size();  i++) {
+    param_slots_.push_back(body_resolver.bind(params_[i]).slot);
+  }
+  for (int i = 0;  i < body_.size();  i++) {
+    body_[i]->resolve(body_resolver);
+  }
+  jit_ = std::make_shared<JitFunction>(this);
+}
+
+
+void ASTCallNamed::resolve(Resolver& resolver) {
+  address_ = resolver.lookup(name_);
+  for (int i = 0;  i < args_.size();  i++) {
+    args_[i]->resolve(resolver);
+  }
+}
+
+
+void ASTAssignment::resolve(Resolver& resolver) {
+  value_->resolve(resolver);
+  address_ = resolver.bind(name_);
+}
+
+
+void ASTDelete::resolve(Resolver& resolver) {
+  address_ = resolver.lookup(name_);
+}
+
+
+void ASTIdentifier::resolve(Resolver& resolver) {
+  address_ = resolver.lookup(name_);
+}
+
+
+//// bytecode //////////////////////////////////////////////////////////////
+
+
+void Code::emit(Opcode op, int arg, int effect) {
+  Instruction instruction;
+  instruction.op = op;
+  instruction.arg = arg;
+  instructions_.push_back(instruction);
+
+  depth_ += effect;
+  if (depth_ > max_depth_) {
+    max_depth_ = depth_;
+  }
+}
+
+
+int Code::add_constant(Value constant) {
+  constants_.push_back(constant);
+  return constants_.size() - 1;
+}
+
+
+int Code::add_address(const Address& address) {
+  for (int i = 0;  i < addresses_.size();  i++) {
+    if (addresses_[i].kind == address.kind  &&
+        addresses_[i].symbol == address.symbol  &&
+        addresses_[i].slot == address.slot) {
+      return i;
+    }
+  }
+  addresses_.push_back(address);
+  return addresses_.size() - 1;
+}
+
+
+int Code::add_function(ASTDefineFun* function) {
+  functions_.push_back(function);
+  return functions_.size() - 1;
+}
+
+
+int Code::add_call(const CallSite& call) {
+  calls_.push_back(call);
+  return calls_.size() - 1;
+}
+
+
+int Code::add_pipeline(const PipelineSite& pipeline) {
+  pipelines_.push_back(pipeline);
+  return pipelines_.size() - 1;
+}
+
+
+std::shared_ptr<Code> compile(const std::vector<ASTNode*>& statements) {
+  std::shared_ptr<Code> code = std::make_shared<Code>();
+
+  if (statements.size() == 0) {
+    // an empty function body returns nothing
+    code->emit(OP_LOAD_CONST, code->add_constant(Value()), 1);
+  }
+
+  for (int i = 0;  i < statements.size();  i++) {
+    if (i != 0) {
+      // only the last statement's value is returned
+      code->emit(OP_POP, 0, -1);
+    }
+    statements[i]->compile(*code);
+  }
+
+  code->emit(OP_RETURN, 0, -1);
+  return code;
+}
+
+
+void ASTLiteralInt::compile(Code& code) {
+  code.emit(OP_LOAD_CONST, code.add_constant(Value(value_)), 1);
+}
+
+
+void ASTLiteralList::compile(Code& code) {
+  for (int i = 0;  i < values_.size();  i++) {
+    values_[i]->compile(code);
+  }
+  code.emit(OP_BUILD_LIST, values_.size(), 1 - (int)values_.size());
+}
+
+
+void ASTDefineFun::compile(Code& code) {
+  // compiled now, rather than on first call, because the first calls might be on many threads
+  if (!code_) {
+    code_ = ::compile(body_);
+  }
+  code.emit(OP_MAKE_FUNCTION, code.add_function(this), 1);
+}
+
+
+int ASTCallNamed::add_call_site(Code& code) {
+  CallSite call = { name_, address_ };
+  call.num_args = args_.size();
+  call.node = this;
+  return code.add_call(call);
+}
+
+
+bool ASTCallNamed::compile_pipeline(Code& code) {
+  // a third argument to 'reduce' would be evaluated before the maps run, rather than after,
+  // so it has to be something that the mapped functions can't change (not even a variable,
+  // which they could reassign or delete)
+  bool is_reduce = name_ == "reduce"  &&  (
+    args_.size() == 2  ||  (args_.size() == 3  &&  dynamic_cast<ASTLiteralInt*>(args_[2]))
+  );
+  bool is_map = name_ == "map"  &&  args_.size() == 2;
+  if (!is_reduce  &&  !is_map) {
+    return false;
+  }
+
+  std::vector<ASTCallNamed*> maps;
+  ASTNode* source = args_[1];
+  while (true) {
+    ASTCallNamed* inner = dynamic_cast<ASTCallNamed*>(source);
+    if (!inner  ||  inner->name() != "map"  ||  inner->args().size() != 2) {
+      break;
+    }
+    maps.push_back(inner);
+    source = inner->args()[1];
+  }
+  if (maps.size() == 0) {
+    return false;
+  }
+
+  // everything is evaluated in the same order as unfused calls; only the calls themselves are fused
+  PipelineSite pipeline;
+  pipeline.outer_call = add_call_site(code);
+  pipeline.has_initial = args_.size() == 3;
+
+  code.emit(OP_LOAD_CALLEE, pipeline.outer_call, 1);
+  args_[0]->compile(code);
+  for (int k = 0;  k < maps.size();  k++) {
+    int index = maps[k]->add_call_site(code);
+    pipeline.map_calls.push_back(index);
+    code.emit(OP_LOAD_CALLEE, index, 1);
+    maps[k]->args()[0]->compile(code);
+  }
+  source->compile(code);
+  if (pipeline.has_initial) {
+    args_[2]->compile(code);
+  }
+
+  code.emit(OP_CALL_PIPELINE, code.add_pipeline(pipeline), 1 - pipeline.num_items());
+  return true;
+}
+
+
+void ASTCallNamed::compile(Code& code) {
+  if (compile_pipeline(code)) {
+    return;
+  }
+
+  int index = add_call_site(code);
+
+  // the function is looked up before its arguments are evaluated, as in run
+  code.emit(OP_LOAD_CALLEE, index, 1);
+  for (int i = 0;  i < args_.size();  i++) {
+    args_[i]->compile(code);
+  }
+  code.emit(OP_CALL, index, -(int)args_.size());
+}
+
+
+void ASTAssignment::compile(Code& code) {
+  value_->compile(code);
+  code.emit(OP_STORE_NAME, code.add_address(address_), 0);
+}
+
+
+void ASTDelete::compile(Code& code) {
+  code.emit(OP_DELETE_NAME, code.add_address(address_), 1);
+}
+
+
+void ASTIdentifier::compile(Code& code) {
+  code.emit(OP_LOAD_NAME, code.add_address(address_), 1);
+}
+
+
+// what OP_CALL does, once the function and its arguments are known
+inline Value call_function(
+  const CallSite& call,
+  ObjectFunction* fun,
+  Args args,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  stack.push_back(call.node);
+  Value result;
+  try {
+    if (fun->needs_frame()) {
+      std::shared_ptr<Scope> frame = scope->begin_frame(scope);
+      result = fun->run(frame, stack, args);
+      scope->end_frame(frame);
+    }
+    else {
+      result = fun->run(scope, stack, args);
+    }
+  }
+  catch (DataError const& exception) {
+    throw error(stack, exception.what());
+  }
+  stack.pop_back();
+
+  return result;
+}
+
+
+// the native loop of a fused reduce(add or mul, map(f, array)), specialized for each dtype
+template <typename T>
+int native_reduce_array(
+  NativeFunction native,
+  const ObjectListArray<T>* array,
+  int64_t start,
+  int64_t stop,
+  bool add,
+  int accumulator
+) {
+  // wrapping around as int arithmetic does, without signed overflow
+  const T* data = array->data();
+  uint32_t result = accumulator;
+  for (int64_t i = start;  i < stop;  i++) {
+    int arg = item_int(data[i]);
+    result = add ? result + (uint32_t)native(&arg) : result * (uint32_t)native(&arg);
+  }
+  return (int32_t)result;
+}
+
+
+Value run_pipeline(
+  const Code& code,
+  const PipelineSite& pipeline,
+  Value* items,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  const CallSite& outer_call = code.calls()[pipeline.outer_call];
+  int num_maps = pipeline.map_calls.size();
+  Value source = items[2 + 2 * num_maps];
+  Value initial = pipeline.has_initial ? items[3 + 2 * num_maps] : Value();
+
+  // names can be reassigned, so only fuse if they're still the builtins, called correctly
+  bool fusable = as_function(items[1].object())  &&
+                 as_list(source.object());
+  if (outer_call.name == "reduce") {
+    fusable = fusable  &&  has_type(items[0].object(), OBJECT_FUNCTION_REDUCE);
+  }
+  else {
+    fusable = fusable  &&  has_type(items[0].object(), OBJECT_FUNCTION_MAP);
+  }
+  for (int k = 0;  k < num_maps;  k++) {
+    fusable = fusable  &&
+              has_type(items[2 + 2 * k].object(), OBJECT_FUNCTION_MAP)  &&
+              as_function(items[3 + 2 * k].object());
+  }
+
+  if (!fusable) {
+    // make the calls one at a time, from the inside out, as unfused OP_CALLs would
+    Value result = source;
+    for (int k = num_maps - 1;  k >= 0;  k--) {
+      Value args[2] = { items[3 + 2 * k], result };
+
+      ObjectFunction* fun = static_cast<ObjectFunction*>(items[2 + 2 * k].object());
+      result = call_function(code.calls()[pipeline.map_calls[k]], fun, Args(args, 2), scope, stack);
+    }
+
+    Value args[3] = { items[1], result, initial };
+
+    ObjectFunction* fun = static_cast<ObjectFunction*>(items[0].object());
+    return call_function(outer_call, fun, Args(args, pipeline.has_initial ? 3 : 2), scope, stack);
+  }
+
+  ObjectList* source_list = static_cast<ObjectList*>(source.object());
+  ObjectFunction* outer_function = static_cast<ObjectFunction*>(items[1].object());
+
+  // the piece of source_list being worked on (see for_each_piece)
+  const ObjectList* list = nullptr;
+  const ObjectListInt32* list_int32 = nullptr;
+  const ObjectListRange* list_range = nullptr;
+  const ObjectListArrayBase* list_array = nullptr;
+  auto set_piece = [&](const ObjectList* piece) {
+    list = piece;
+    list_int32 = as_list_int32(piece);
+    list_array = as_list_array(piece);
+    list_range = piece->type() == OBJECT_LIST_RANGE ? static_cast<const ObjectListRange*>(piece) : nullptr;
+  };
+
+  std::vector<ObjectFunction*> map_functions;
+  for (int k = 0;  k < num_maps;  k++) {
+    map_functions.push_back(static_cast<ObjectFunction*>(items[3 + 2 * k].object()));
+  }
+
+  // each call gets its own nested Scope, as though it were run separately (the last is the outer call's)
+  auto nested_scopes = [&](const std::shared_ptr<Scope>& scope) {
+    std::vector<std::shared_ptr<Scope>> scopes;
+    for (int k = 0;  k <= num_maps;  k++) {
+      scopes.push_back(std::make_shared<Scope>(scope));
+    }
+    return scopes;
+  };
+
+  // passes one item through all of the maps, without making any intermediate lists
+  auto mapped = [&](
+    int64_t i,
+    const std::vector<std::shared_ptr<Scope>>& scopes,
+    std::vector<ASTNode*>& stack
+  ) {
+    Value item = list->get(i);
+    for (int k = num_maps - 1;  k >= 0;  k--) {
+      stack.push_back(code.calls()[pipeline.map_calls[k]].node);
+      item = map_functions[k]->run(scopes[k], stack, Args(&item, 1));
+      stack.pop_back();
+    }
+    return item;
+  };
+
+  auto outer = [&](
+    Args args,
+    const std::vector<std::shared_ptr<Scope>>& scopes,
+    std::vector<ASTNode*>& stack
+  ) {
+    stack.push_back(outer_call.node);
+    Value result = outer_function->run(scopes[num_maps], stack, args);
+    stack.pop_back();
+    return result;
+  };
+
+  // reduce(add or mul, map(f, int32 list, array, or range)) runs without any Values once f is native code
+  bool outer_add = has_type(outer_function, OBJECT_FUNCTION_ADD);
+  bool outer_mul = has_type(outer_function, OBJECT_FUNCTION_MUL);
+  auto native_map = [&](
+    const std::vector<std::shared_ptr<Scope>>& scopes,
+    std::vector<ASTNode*>& stack
+  ) -> NativeFunction {
+    if (!jit_enabled  ||  num_maps != 1  ||  (!list_int32  &&  !list_range  &&  !list_array)  ||  (!outer_add  &&  !outer_mul)) {
+      return nullptr;
+    }
+    stack.push_back(code.calls()[pipeline.map_calls[0]].node);
+    NativeFunction native = native_code(map_functions[0], scopes[0].get(), stack);
+    stack.pop_back();
+    return native;
+  };
+
+  if (outer_call.name == "reduce") {
+    std::vector<std::shared_ptr<Scope>> scopes = nested_scopes(scope);
+    Value result = initial;
+    bool has_result = pipeline.has_initial;
+
+    if (!has_result  &&  source_list->size() == 0) {
+      stack.push_back(outer_call.node);
+      throw error(stack, "'reduce' function's list argument can only be empty if a third argument (the initial value) is provided");
+    }
+
+    // each piece continues from the previous piece's result
+    for_each_piece(source_list, 0, stack, [&](const ObjectList* piece, int64_t start) {
+      set_piece(piece);
+
+      if (!has_result) {
+        result = mapped(start, scopes, stack);
+        has_result = true;
+        start++;
+      }
+
+      int64_t size = list->size() - start;
+      int chunks = outer_function->associative() ? num_chunks(size) : 1;
+      std::vector<Value> partial(chunks);
+
+      run_chunks(chunks, size, scope, stack, [&](
+        int chunk,
+        int64_t chunk_start,
+        int64_t chunk_stop,
+        const std::shared_ptr<Scope>& chunk_scope,
+        std::vector<ASTNode*>& stack
+      ) {
+        std::vector<std::shared_ptr<Scope>> chunk_scopes = chunks == 1 ? scopes : nested_scopes(chunk_scope);
+
+        // with one chunk, this is the whole reduction; otherwise, a partial result
+        Value chunk_result = result;
+        int64_t i = start + chunk_start;
+        if (chunks != 1) {
+          chunk_result = mapped(i++, chunk_scopes, stack);
+        }
+
+        for (;  i < start + chunk_stop;  i++) {
+          NativeFunction native = chunk_result.is_int() ? native_map(chunk_scopes, stack) : nullptr;
+          if (native) {
+            int accumulator = chunk_result.to_int();
+            if (list_array) {
+              switch (list_array->dtype()) {
+#define CASE(DTYPE, T) case DTYPE: accumulator = native_reduce_array(native, static_cast<const ObjectListArray<T>*>(list_array), i, start + chunk_stop, outer_add, accumulator); break;
+                FOR_EACH_ARRAY_DTYPE(CASE)
+#undef CASE
+                default: break;
+              }
+              i = start + chunk_stop;
+            }
+            uint32_t result = accumulator;
+            for (;  i < start + chunk_stop;  i++) {
+              int arg = list_int32 ? list_int32->data()[i] : list_range->item(i);
+              result = outer_add ? result + (uint32_t)native(&arg) : result * (uint32_t)native(&arg);
+            }
+            chunk_result = Value((int32_t)result);
+            break;
+          }
+
+          Value fargs[2] = { std::move(chunk_result), mapped(i, chunk_scopes, stack) };
+
+          chunk_result = outer(Args(fargs, 2), chunk_scopes, stack);
+        }
+
+        partial[chunk] = chunk_result;
+      });
+
+      if (chunks == 1) {
+        result = partial[0];
+        return;
+      }
+
+      stack.push_back(outer_call.node);
+      result = combine_partial(outer_function, result, partial, scopes[num_maps], stack);
+      stack.pop_back();
+    });
+
+    return result;
+  }
+
+  else {
+    ListBuilder values(source_list->size());
+
+    for_each_piece(source_list, 0, stack, [&](const ObjectList* piece, int64_t piece_start) {
+      set_piece(piece);
+      int64_t size = list->size() - piece_start;
+      int chunks = num_chunks(size);
+      std::vector<ListBuilder> chunk_values(chunks, ListBuilder(size / chunks + 1));
+
+      run_chunks(chunks, size, scope, stack, [&](
+        int chunk,
+        int64_t start,
+        int64_t stop,
+        const std::shared_ptr<Scope>& chunk_scope,
+        std::vector<ASTNode*>& stack
+      ) {
+        std::vector<std::shared_ptr<Scope>> chunk_scopes = nested_scopes(chunk_scope);
+
+        for (int64_t i = piece_start + start;  i < piece_start + stop;  i++) {
+          Value farg = mapped(i, chunk_scopes, stack);
+
+          chunk_values[chunk].append(outer(Args(&farg, 1), chunk_scopes, stack));
+        }
+      });
+
+      for (int chunk = 0;  chunk < chunks;  chunk++) {
+        values.extend(chunk_values[chunk]);
+      }
+    });
+
+    return values.finish();
+  }
+}
+
+
+// GCC and Clang can jump straight from one instruction's handler to the next
+// ("computed goto"), which predicts much better than a single switch
+#if defined(__GNUC__) && !defined(BABY_PYTHON_NO_COMPUTED_GOTO)
+#define USE_COMPUTED_GOTO 1
+#else
+#define USE_COMPUTED_GOTO 0
+#endif
+
+
+Value run_code(
+  const Code& code,
+  const std::shared_ptr<Scope>& scope,
+  std::vector<ASTNode*>& stack
+) {
+  // the value stack lives in this C++ stack frame unless it's unusually deep; it starts out
+  // uninitialized, and Values are constructed as they're pushed and destroyed as they're popped
+  typedef std::aligned_storage<sizeof(Value), alignof(Value)>::type ValueStorage;
+  const int SMALL_DEPTH = 8;
+  ValueStorage small_values[SMALL_DEPTH];
+  std::unique_ptr<ValueStorage[]> large_values;
+  Value* values = reinterpret_cast<Value*>(small_values);
+  if (code.max_depth() > SMALL_DEPTH) {
+    large_values.reset(new ValueStorage[code.max_depth()]);
+    values = reinterpret_cast<Value*>(large_values.get());
+  }
+  Value* top = values;   // one past the last value
+
+  // whatever is still on the stack when this returns (or throws)
+  struct PopAll {
+    Value* values;
+    Value*& top;
+    ~PopAll() {
+      while (top != values) {
+        (--top)->~Value();
+      }
+    }
+  } pop_all = { values, top };
+
+  const Instruction* ip = code.instructions().data();
+
+#if USE_COMPUTED_GOTO
+  static void* dispatch_table[NUM_OPCODES] = {
+    &&target_OP_LOAD_CONST,
+    &&target_OP_LOAD_NAME,
+    &&target_OP_STORE_NAME,
+    &&target_OP_DELETE_NAME,
+    &&target_OP_BUILD_LIST,
+    &&target_OP_MAKE_FUNCTION,
+    &&target_OP_LOAD_CALLEE,
+    &&target_OP_CALL,
+    &&target_OP_CALL_PIPELINE,
+    &&target_OP_POP,
+    &&target_OP_RETURN
+  };
+// a computed goto doesn't run destructors on the way out of a block, so any handler with
+// locals that have them keeps those locals in an inner block that ends before DISPATCH
+#define TARGET(op) target_##op: case op:
+#define DISPATCH() goto *dispatch_table[ip->op]
+#else
+#define TARGET(op) case op:
+#define DISPATCH() continue
+#endif
+
+  while (true) {
+    switch (ip->op) {
+
+      TARGET(OP_LOAD_CONST) {
+        new (top) Value(code.constants()[ip->arg]);
+        top++;
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_LOAD_NAME) {
+        new (top) Value(scope->get(code.addresses()[ip->arg], stack));
+        top++;
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_STORE_NAME) {
+        scope->assign(code.addresses()[ip->arg], top[-1], stack);
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_DELETE_NAME) {
+        new (top) Value(scope->del(code.addresses()[ip->arg], stack));
+        top++;
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_BUILD_LIST) {
+        {
+          ListBuilder items(ip->arg);
+          Value* first = top - ip->arg;
+          for (Value* item = first;  item != top;  item++) {
+            items.append(std::move(*item));
+          }
+          while (top != first) {
+            (--top)->~Value();
+          }
+          new (top) Value(items.finish());
+          top++;
+        }
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_MAKE_FUNCTION) {
+        ASTDefineFun* fun = code.functions()[ip->arg];
+        new (top) Value(std::make_shared<ObjectUserFunction>(fun->arena()->share(fun)));
+        top++;
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_LOAD_CALLEE) {
+        const CallSite& call = code.calls()[ip->arg];
+
+        if (stack.size() == MAX_RECURSION) {
+          throw error(stack, "recursion is too deep (probably an infinite loop)");
+        }
+
+        Value* maybe_fun = scope->locate_callee(call.address);
+
+        if (!maybe_fun) {
+          throw error(stack, "there is no variable named '" + symbol_name(call.address.symbol) + "'");
+        }
+        if (!as_function(maybe_fun->object())) {
+          throw error(stack, "attempting to call an object that is not a function");
+        }
+
+        new (top) Value(*maybe_fun);
+        top++;
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_CALL) {
+        const CallSite& call = code.calls()[ip->arg];
+
+        // the arguments are lent to the function where they are, on the value stack
+        Value* args = top - call.num_args;
+
+        // checked by OP_LOAD_CALLEE
+        ObjectFunction* fun = static_cast<ObjectFunction*>(args[-1].object());
+
+        {
+          Value result = call_function(call, fun, Args(args, call.num_args), scope, stack);
+          while (top != args) {
+            (--top)->~Value();
+          }
+          top[-1] = std::move(result);
+        }
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_CALL_PIPELINE) {
+        const PipelineSite& pipeline = code.pipelines()[ip->arg];
+        Value* items = top - pipeline.num_items();
+
+        {
+          Value result;
+          size_t depth = stack.size();
+          try {
+            result = run_pipeline(code, pipeline, items, scope, stack);
+          }
+          catch (DataError const& exception) {
+            // the source list's items are read by the innermost map (unless it happened in a call
+            // that's on the stack already)
+            if (stack.size() == depth) {
+              stack.push_back(code.calls()[pipeline.map_calls.back()].node);
+            }
+            throw error(stack, exception.what());
+          }
+
+          while (top != items) {
+            (--top)->~Value();
+          }
+          new (top) Value(std::move(result));
+          top++;
+        }
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_POP) {
+        (--top)->~Value();
+        ip++;
+        DISPATCH();
+      }
+
+      TARGET(OP_RETURN) {
+        return std::move(top[-1]);
+      }
+
+      default:
+        throw std::runtime_error("unknown bytecode instruction");
+    }
+  }
+
+#undef TARGET
+#undef DISPATCH
+}
+
+
+//// JIT ///////////////////////////////////////////////////////////////////
+
+
+void JitFunction::count_int_call() {
+  if (failed_  ||  native_) {
+    return;
+  }
+  if (++int_calls_ == JIT_THRESHOLD) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!compile()) {
+      failed_ = true;
+    }
+  }
+}
+
+
+NativeFunction JitFunction::native(Scope* scope, std::vector<ASTNode*>& stack) {
+  NativeFunction native = native_.load(std::memory_order_acquire);
+  if (!native) {
+    return nullptr;
+  }
+
+  // the interpreter would report this, so let it
+  if (has_calls_  &&  stack.size() >= MAX_RECURSION) {
+    return nullptr;
+  }
+
+  // names are looked up when they're called, so 'add' and 'mul' might not be the builtins any more
+  for (int i = 0;  i < callees_.size();  i++) {
+    Value* callee = scope->locate(callees_[i].address);
+    Object* object = callee ? callee->object() : nullptr;
+    if (callees_[i].is_mul ? !has_type(object, OBJECT_FUNCTION_MUL) : !has_type(object, OBJECT_FUNCTION_ADD)) {
+      return nullptr;
+    }
+  }
+
+  return native;
+}
+
+
+bool JitFunction::compile() {
+#if HAVE_JIT
+  if (fun_->params().size() > MAX_JIT_PARAMS  ||  fun_->body().size() != 1) {
+    return false;
+  }
+
+  // the function's result is left in eax; 'args' is in rdi
+  has_calls_ = false;
+  std::vector<uint8_t> machine_code;
+  if (!emit(fun_->body()[0], machine_code)) {
+    return false;
+  }
+  machine_code.push_back(0xC3);                                  // ret
+
+  // written while the pages are writable, then made executable (never both at once)
+  size_t length = machine_code.size();
+  void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED) {
+    return false;
+  }
+  memory_ = std::shared_ptr<void>(address, [length](void* address) { munmap(address, length); });
+  std::memcpy(address, machine_code.data(), length);
+  if (mprotect(address, length, PROT_READ | PROT_EXEC) == -1) {
+    return false;
+  }
+
+  native_.store(reinterpret_cast<NativeFunction>(address), std::memory_order_release);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+bool JitFunction::emit(const ASTNode* node, std::vector<uint8_t>& machine_code) {
+  const ASTLiteralInt* literal = dynamic_cast<const ASTLiteralInt*>(node);
+  const ASTIdentifier* identifier = dynamic_cast<const ASTIdentifier*>(node);
+  const ASTCallNamed* call = dynamic_cast<const ASTCallNamed*>(node);
+
+  if (literal) {
+    uint32_t value = literal->value();
+    machine_code.push_back(0xB8);                                // mov eax, imm32
+    for (int i = 0;  i < 4;  i++) {
+      machine_code.push_back((value >> (8 * i)) & 0xFF);
+    }
+    return true;
+  }
+
+  else if (identifier) {
+    // a parameter (the body has no assignments or deletions, so its slot holds the argument)
+    if (identifier->address().kind != ADDRESS_LOCAL) {
+      return false;
+    }
+    int param = -1;
+    for (int i = 0;  i < fun_->param_slots().size();  i++) {
+      if (fun_->param_slots()[i] == identifier->address().slot) {
+        param = i;   // the last one, if a name is repeated
+      }
+    }
+    if (param == -1) {
+      return false;
+    }
+    machine_code.push_back(0x8B);                                // mov eax, [rdi + 4*param]
+    machine_code.push_back(0x47);
+    machine_code.push_back(4 * param);
+    return true;
+  }
+
+  else if (call) {
+    bool is_add = call->name() == "add";
+    bool is_mul = call->name() == "mul";
+    if ((!is_add  &&  !is_mul)  ||  call->address().kind != ADDRESS_FREE  ||  call->args().size() != 2) {
+      return false;
+    }
+    JitCallee callee = { call->address(), is_mul };
+    callees_.push_back(callee);
+    has_calls_ = true;
+
+    if (!emit(call->args()[0], machine_code)) {
+      return false;
+    }
+    machine_code.push_back(0x50);                                // push rax
+    if (!emit(call->args()[1], machine_code)) {
+      return false;
+    }
+    machine_code.push_back(0x59);                                // pop rcx
+    if (is_add) {
+      machine_code.push_back(0x01);                              // add eax, ecx
+      machine_code.push_back(0xC8);
+    }
+    else {
+      machine_code.push_back(0x0F);                              // imul eax, ecx
+      machine_code.push_back(0xAF);
+      machine_code.push_back(0xC1);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+
+JitFunction* ObjectUserFunction::jit() {
+  return fun_->jit();
+}
+
+
+NativeFunction native_code(
+  ObjectFunction* function,
+  Scope* scope,
+  std::vector<ASTNode*>& stack
+) {
+  if (!jit_enabled  ||  eval_mode != EVAL_BYTECODE  ||  !has_type(function, OBJECT_USER_FUNCTION)) {
+    return nullptr;
+  }
+  return static_cast<ObjectUserFunction*>(function)->jit()->native(scope, stack);
+}
+
+
+//// data files //////////////////////////////////////////////////////////
+
+
+const char* const DTYPE_NAMES[] = {
+  "int8", "uint8", "int16", "uint16", "int32", "uint32", "int64", "uint64", "float32", "float64"
+};
+const int DTYPE_SIZES[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+
+
+bool parse_dtype(const std::string& name, DType& dtype) {
+  for (int i = 0;  i <= DTYPE_FLOAT64;  i++) {
+    if (name == DTYPE_NAMES[i]) {
+      dtype = (DType)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+const char* dtype_name(DType dtype) {
+  return DTYPE_NAMES[dtype];
+}
+
+
+int dtype_size(DType dtype) {
+  return DTYPE_SIZES[dtype];
+}
+
+
+DType suffix_dtype(const std::string& file_name) {
+  DType dtype = DTYPE_INT32;
+  std::string::size_type dot = file_name.rfind('.');
+  if (dot != std::string::npos) {
+    parse_dtype(file_name.substr(dot + 1), dtype);
+  }
+  return dtype;
+}
+
+
+// 'size' items of type 'dtype' at 'data', which 'storage' keeps alive
+std::shared_ptr<ObjectList> make_array(
+  DType dtype,
+  const void* data,
+  int64_t size,
+  std::shared_ptr<const void> storage
+) {
+  switch (dtype) {
+    case DTYPE_INT32:
+      return std::make_shared<ObjectListInt32>(reinterpret_cast<const int32_t*>(data), size, storage);
+#define CASE(DTYPE, T) case DTYPE: return std::make_shared<ObjectListArray<T>>(reinterpret_cast<const T*>(data), size, storage);
+    FOR_EACH_ARRAY_DTYPE(CASE)
+#undef CASE
+    default:
+      throw std::runtime_error(std::string("no list type for ") + dtype_name(dtype));
+  }
+}
+
+
+// the bytes of a file, in memory: 'data' points at them and 'storage' keeps them there
+struct FileBytes {
+  const char* data;
+  size_t length;
+  std::shared_ptr<const void> storage;
+};
+
+
+#if HAVE_MMAP
+FileBytes map_file(const std::string& file_name, const LoadOptions& options) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("could not open file: " + file_name);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    throw std::runtime_error("could not get the size of file: " + file_name);
+  }
+
+  size_t length = info.st_size;
+  if (length == 0) {
+    // mmap can't map zero bytes
+    close(fd);
+    return FileBytes{nullptr, 0, nullptr};
+  }
+
+  int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (options.populate) {
+    flags |= MAP_POPULATE;
+  }
+#endif
+
+  void* address = mmap(nullptr, length, PROT_READ, flags, fd, 0);
+  close(fd);   // the mapping keeps the file open
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("could not map file into memory: " + file_name);
+  }
+
+  // analyses read the data front to back, so the kernel can read ahead aggressively
+  madvise(address, length, MADV_SEQUENTIAL);
+
+  std::shared_ptr<const void> storage(address, [length](const void* address) {
+    munmap(const_cast<void*>(address), length);
+  });
+
+  return FileBytes{reinterpret_cast<const char*>(address), length, storage};
+}
+#endif
+
+
+FileBytes read_file(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("could not open file: " + file_name);
+  }
+
+  file.seekg(0, std::ios::end);
+  std::streamoff length = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  // one read for the whole file, into words that are aligned for any dtype
+  std::shared_ptr<std::vector<uint64_t>> words = std::make_shared<std::vector<uint64_t>>(
+    (length + sizeof(uint64_t) - 1) / sizeof(uint64_t)
+  );
+  file.read(reinterpret_cast<char*>(words->data()), length);
+  if (!file) {
+    throw std::runtime_error("could not read file: " + file_name);
+  }
+
+  file.close();
+
+  return FileBytes{reinterpret_cast<const char*>(words->data()), (size_t)length, words};
+}
+
+
+FileBytes file_bytes(const std::string& file_name, const LoadOptions& options) {
+#if HAVE_MMAP
+  if (options.use_mmap) {
+    return map_file(file_name, options);
+  }
+#endif
+  return read_file(file_name);
+}
+
+
+std::atomic<int64_t> bytes_streamed(0);
+
+
+#if HAVE_PREAD
+StreamFile::~StreamFile() {
+  close(fd_);
+}
+
+
+bool StreamFile::read(int64_t index, int64_t count, int32_t* out) const {
+  char* buffer = reinterpret_cast<char*>(out);
+  int64_t remaining = count * sizeof(int32_t);
+  off_t position = index * sizeof(int32_t);
+
+  // pread can return less than was asked for, and is safe to call from several threads at once
+  while (remaining > 0) {
+    ssize_t got = pread(fd_, buffer, remaining, position);
+    if (got < 0  &&  errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    buffer += got;
+    position += got;
+    remaining -= got;
+  }
+
+  bytes_streamed += count * sizeof(int32_t);
+  return true;
+}
+
+
+// items start 'header_size' bytes into the file (a multiple of 4)
+std::shared_ptr<ObjectList> load_int32_stream(
+  const std::string& file_name,
+  const LoadOptions& options,
+  int64_t header_size
+) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("could not open file: " + file_name);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    throw std::runtime_error("could not get the size of file: " + file_name);
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  return std::make_shared<ObjectListStream>(
+    std::make_shared<StreamFile>(file_name, fd, options.read_ahead, options.use_io_uring),
+    header_size / sizeof(int32_t),
+    (info.st_size - header_size) / sizeof(int32_t),
+    options.window_size
+  );
+}
+#else
+StreamFile::~StreamFile() { }
+
+
+bool StreamFile::read(int64_t index, int64_t count, int32_t* out) const {
+  return false;
+}
+#endif
+
+
+Value ObjectListStream::get(int64_t index) const {
+  int32_t item;
+  read(index, index + 1, &item);
+  return Value(item);
+}
+
+
+void ObjectListStream::read(int64_t start, int64_t stop, int32_t* out) const {
+  if (!file_->read(offset_ + start, stop - start, out)) {
+    throw DataError("could not read file: " + file_->name());
+  }
+}
+
+
+// reads windows of a StreamFile in the background, several at once; wait() returns them in the
+// order they were submitted, and the destructor waits for any that are still being read
+class WindowReader {
+public:
+  virtual ~WindowReader() { }
+
+  // starts reading 'count' items from item 'index' of the file into 'out'
+  virtual void submit(int64_t index, int64_t count, int32_t* out) = 0;
+
+  // waits for the oldest read that hasn't been waited for; false if it failed
+  virtual bool wait() = 0;
+};
+
+
+// each read is a pread on one of 'depth' threads, which take them from a queue in order
+class PreadReader: public WindowReader {
+public:
+  PreadReader(const StreamFile& file, int depth);
+  // stops the threads, after the reads that they've started (the rest are dropped)
+  ~PreadReader();
+
+  void submit(int64_t index, int64_t count, int32_t* out) override;
+  bool wait() override;
+
+private:
+  struct Read {
+    int64_t index;
+    int64_t count;
+    int32_t* out;
+    bool done;
+    bool ok;
+  };
+
+  void work();
+
+  const StreamFile& file_;
+  std::deque<Read> reads_;   // submitted and not waited for, oldest first (deques don't move items)
+  size_t next_;              // the first in reads_ that no thread has taken
+  std::mutex mutex_;
+  std::condition_variable submitted_;
+  std::condition_variable finished_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+
+
+#if HAVE_IO_URING
+// all of the reads go through one io_uring: no threads, and one system call to start each read
+class UringReader: public WindowReader {
+public:
+  // nullptr if the kernel doesn't have io_uring (or it isn't allowed here)
+  static std::unique_ptr<UringReader> open(const StreamFile& file, int depth);
+  ~UringReader();
+
+  void submit(int64_t index, int64_t count, int32_t* out) override;
+  bool wait() override;
+
+private:
+  // a read that may take more than one request, if the kernel reads less than was asked for
+  struct Read {
+    struct iovec iov;    // the part that's left
+    off_t position;
+    bool done;
+    bool ok;
+  };
+
+  UringReader(const StreamFile& file, int ring_fd, int depth): file_(file), ring_fd_(ring_fd),
+    reads_(depth), submitted_(0), waited_(0), sq_ring_(nullptr), cq_ring_(nullptr), sqes_(nullptr) { }
+
+  void request(int slot);
+  void reap();
+
+  const StreamFile& file_;
+  int ring_fd_;
+  std::vector<Read> reads_;    // reads in flight, by submission number modulo 'depth'
+  int64_t submitted_;
+  int64_t waited_;
+
+  // the rings shared with the kernel
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+};
+
+
+std::unique_ptr<UringReader> UringReader::open(const StreamFile& file, int depth) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  int ring_fd = syscall(__NR_io_uring_setup, depth, &params);
+  if (ring_fd < 0) {
+    return nullptr;
+  }
+  std::unique_ptr<UringReader> reader(new UringReader(file, ring_fd, depth));
+
+  reader->sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  reader->cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+  single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+  if (single_mmap) {
+    reader->sq_ring_size_ = reader->cq_ring_size_ = std::max(reader->sq_ring_size_, reader->cq_ring_size_);
+  }
+
+  void* sq_ring = mmap(nullptr, reader->sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    return nullptr;
+  }
+  reader->sq_ring_ = sq_ring;
+
+  void* cq_ring = sq_ring;
+  if (!single_mmap) {
+    cq_ring = mmap(nullptr, reader->cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      return nullptr;
+    }
+    reader->cq_ring_ = cq_ring;
+  }
+
+  reader->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, reader->sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return nullptr;
+  }
+  reader->sqes_ = reinterpret_cast<io_uring_sqe*>(sqes);
+
+  char* sq = reinterpret_cast<char*>(sq_ring);
+  char* cq = reinterpret_cast<char*>(cq_ring);
+  reader->sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  reader->sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  reader->sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  reader->cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  reader->cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  reader->cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  reader->cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  return reader;
+}
+
+
+UringReader::~UringReader() {
+  // the kernel may still be writing into the caller's buffers
+  if (sqes_ != nullptr) {
+    while (waited_ < submitted_) {
+      wait();
+    }
+  }
+
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  close(ring_fd_);
+}
+
+
+void UringReader::submit(int64_t index, int64_t count, int32_t* out) {
+  int slot = submitted_ % reads_.size();
+  submitted_++;
+
+  Read& read = reads_[slot];
+  read.iov.iov_base = out;
+  read.iov.iov_len = count * sizeof(int32_t);
+  read.position = index * sizeof(int32_t);
+  read.done = false;
+  read.ok = false;
+  request(slot);
+}
+
+
+// asks the kernel for (the rest of) one read
+void UringReader::request(int slot) {
+  Read& read = reads_[slot];
+
+  // only this thread adds to the submission queue, and the kernel takes each entry before
+  // io_uring_enter returns, so there's always room
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = file_.fd();
+  sqe->off = read.position;
+  sqe->addr = reinterpret_cast<uint64_t>(&read.iov);
+  sqe->len = 1;
+  sqe->user_data = slot;
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  int result;
+  while ((result = syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0)) < 0  &&  errno == EINTR) { }
+  if (result < 0) {
+    // the kernel didn't take it, so take it back
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+    read.done = true;
+    read.ok = false;
+  }
+}
+
+
+// handles every read the kernel has finished
+void UringReader::reap() {
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+  for (;  head != tail;  head++) {
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    int slot = cqe.user_data;
+    Read& read = reads_[slot];
+
+    if (cqe.res > 0) {
+      read.iov.iov_base = reinterpret_cast<char*>(read.iov.iov_base) + cqe.res;
+      read.iov.iov_len -= cqe.res;
+      read.position += cqe.res;
+      bytes_streamed += cqe.res;
+    }
+
+    if (cqe.res > 0  &&  read.iov.iov_len > 0) {
+      // a short read: ask for the rest
+      request(slot);
+    }
+    else if (cqe.res == -EINTR  ||  cqe.res == -EAGAIN) {
+      request(slot);
+    }
+    else {
+      read.done = true;
+      read.ok = read.iov.iov_len == 0;
+    }
+  }
+
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+
+bool UringReader::wait() {
+  Read& read = reads_[waited_ % reads_.size()];
+  waited_++;
+
+  reap();
+  while (!read.done) {
+    if (syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0  &&  errno != EINTR) {
+      return false;
+    }
+    reap();
+  }
+  return read.ok;
+}
+#endif
+
+
+PreadReader::PreadReader(const StreamFile& file, int depth)
+  : file_(file), next_(0), stopping_(false) {
+  for (int i = 0;  i < depth;  i++) {
+    threads_.emplace_back(&PreadReader::work, this);
+  }
+}
+
+
+PreadReader::~PreadReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  submitted_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+
+void PreadReader::submit(int64_t index, int64_t count, int32_t* out) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reads_.push_back(Read{index, count, out, false, false});
+  }
+  submitted_.notify_one();
+}
+
+
+bool PreadReader::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return reads_.front().done; });
+  bool ok = reads_.front().ok;
+  reads_.pop_front();
+  next_--;
+  return ok;
+}
+
+
+void PreadReader::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    submitted_.wait(lock, [this]() { return stopping_  ||  next_ < reads_.size(); });
+    if (stopping_) {
+      return;
+    }
+    Read& read = reads_[next_++];
+
+    lock.unlock();
+    bool ok = file_.read(read.index, read.count, read.out);
+    lock.lock();
+
+    read.ok = ok;
+    read.done = true;
+    finished_.notify_all();
+  }
+}
+
+
+std::unique_ptr<WindowReader> open_window_reader(const StreamFile& file, int depth) {
+#if HAVE_IO_URING
+  if (file.use_io_uring()) {
+    std::unique_ptr<UringReader> reader = UringReader::open(file, depth);
+    if (reader) {
+      return reader;
+    }
+  }
+#endif
+  return std::unique_ptr<WindowReader>(new PreadReader(file, depth));
+}
+
+
+void ObjectListStream::for_each_window(
+  int64_t start,
+  std::vector<ASTNode*>& stack,
+  const std::function<void(const ObjectList* piece, int64_t start)>& body
+) const {
+  // one window is used while the next 'depth' are read into the others
+  int depth = file_->read_ahead();
+  std::vector<std::shared_ptr<std::vector<int32_t>>> buffers(depth + 1);
+  std::unique_ptr<WindowReader> reader = open_window_reader(*file_, depth);   // after 'buffers', so it's destroyed first
+
+  int64_t next_start = start;
+  int64_t submitted = 0;
+  auto submit_next = [&]() {
+    // if anything still has this buffer (from an earlier window), leave it and make a new one
+    std::shared_ptr<std::vector<int32_t>>& buffer = buffers[submitted % buffers.size()];
+    if (!buffer  ||  buffer.use_count() > 1) {
+      buffer = std::make_shared<std::vector<int32_t>>();
+    }
+    int64_t next_stop = std::min(next_start + window_size_, size_);
+    buffer->resize(next_stop - next_start);
+    reader->submit(offset_ + next_start, next_stop - next_start, buffer->data());
+    next_start = next_stop;
+    submitted++;
+  };
+
+  while (submitted < depth  &&  next_start < size_) {
+    submit_next();
+  }
+
+  for (int64_t window_index = 0;  window_index < submitted;  window_index++) {
+    if (!reader->wait()) {
+      throw error(stack, "could not read file: " + file_->name());
+    }
+    // reuses the buffer of the window before this one
+    if (next_start < size_) {
+      submit_next();
+    }
+
+    const std::shared_ptr<std::vector<int32_t>>& buffer = buffers[window_index % buffers.size()];
+    std::shared_ptr<ObjectListInt32> window = std::make_shared<ObjectListInt32>(
+      buffer->data(), buffer->size(), buffer
+    );
+    body(window.get(), 0);
+  }
+}
+
+
+void check_loadable(DType dtype) {
+  if (dtype == DTYPE_FLOAT32  ||  dtype == DTYPE_FLOAT64) {
+    throw std::runtime_error(std::string(dtype_name(dtype)) + " data files can't be loaded: baby-python's numbers are all integers");
+  }
+}
+
+
+std::shared_ptr<ObjectList> load_data(const std::string& file_name, DType dtype, const LoadOptions& options) {
+  check_loadable(dtype);
+#if HAVE_PREAD
+  if (options.stream  &&  dtype == DTYPE_INT32) {
+    return load_int32_stream(file_name, options, 0);
+  }
+#endif
+  // a trailing partial item is ignored
+  FileBytes bytes = file_bytes(file_name, options);
+  return make_array(dtype, bytes.data, bytes.length / dtype_size(dtype), bytes.storage);
+}
+
+
+// what the header of a .npy file says about the array after it
+struct NpyHeader {
+  DType dtype;
+  bool swap_bytes;             // stored in the other byte order from this computer's
+  bool fortran_order;          // the first index varies fastest, rather than the last
+  std::vector<int64_t> shape;
+  int64_t data_offset;         // where the items start, in bytes from the start of the file
+};
+
+
+// the text just after 'key': in the dictionary of a .npy header, or "" if it isn't there
+std::string npy_field(const std::string& header, const std::string& key) {
+  std::string::size_type pos = header.find("'" + key + "'");
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos = header.find(':', pos);
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos = header.find_first_not_of(" ", pos + 1);
+  return pos == std::string::npos ? "" : header.substr(pos);
+}
+
+
+NpyHeader read_npy_header(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("could not open file: " + file_name);
+  }
+  std::runtime_error bad_header("not a .npy file that baby-python can read: " + file_name);
+
+  // magic string, version, then the length of the header (2 bytes in version 1, 4 after that)
+  unsigned char prefix[12];
+  file.read(reinterpret_cast<char*>(prefix), 10);
+  if (!file  ||  std::memcmp(prefix, "\x93NUMPY", 6) != 0) {
+    throw bad_header;
+  }
+  int64_t header_length = prefix[8] | (prefix[9] << 8);
+  int64_t data_offset = 10;
+  if (prefix[6] >= 2) {
+    file.read(reinterpret_cast<char*>(prefix + 10), 2);
+    header_length |= ((int64_t)prefix[10] << 16) | ((int64_t)prefix[11] << 24);
+    data_offset = 12;
+  }
+  std::string header(header_length, ' ');
+  file.read(&header[0], header_length);
+  if (!file) {
+    throw bad_header;
+  }
+
+  NpyHeader out;
+  out.data_offset = data_offset + header_length;
+
+  // 'descr': '<i4' is the byte order, kind, and size of the items
+  std::string descr = npy_field(header, "descr");
+  std::string::size_type close = descr.find(descr.empty() ? '\'' : descr[0], 1);
+  if (descr.empty()  ||  (descr[0] != '\''  &&  descr[0] != '"')  ||  close == std::string::npos) {
+    throw bad_header;
+  }
+  descr = descr.substr(1, close - 1);
+  char order = '=';
+  if (!descr.empty()  &&  std::strchr("<>|=", descr[0])) {
+    order = descr[0];
+    descr = descr.substr(1);
+  }
+  static const std::pair<const char*, DType> DESCRS[] = {
+    {"i1", DTYPE_INT8}, {"u1", DTYPE_UINT8}, {"b1", DTYPE_UINT8}, {"i2", DTYPE_INT16}, {"u2", DTYPE_UINT16},
+    {"i4", DTYPE_INT32}, {"u4", DTYPE_UINT32}, {"i8", DTYPE_INT64}, {"u8", DTYPE_UINT64},
+    {"f4", DTYPE_FLOAT32}, {"f8", DTYPE_FLOAT64}
+  };
+  bool found = false;
+  for (const std::pair<const char*, DType>& known : DESCRS) {
+    if (descr == known.first) {
+      out.dtype = known.second;
+      found = true;
+    }
+  }
+  if (!found) {
+    throw std::runtime_error(".npy dtype '" + descr + "' isn't supported: " + file_name);
+  }
+  const uint16_t probe = 1;
+  bool little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+  out.swap_bytes = dtype_size(out.dtype) > 1  &&  ((order == '<'  &&  !little_endian)  ||  (order == '>'  &&  little_endian));
+
+  out.fortran_order = npy_field(header, "fortran_order").substr(0, 4) == "True";
+
+  // 'shape': (1000, 3) has a trailing comma for one dimension, and is () for none
+  std::string shape = npy_field(header, "shape");
+  if (shape.empty()  ||  shape[0] != '('  ||  shape.find(')') == std::string::npos) {
+    throw bad_header;
+  }
+  shape = shape.substr(1, shape.find(')') - 1);
+  for (std::string::size_type pos = 0;  pos < shape.size();  pos++) {
+    if (std::isdigit(shape[pos])) {
+      out.shape.push_back(std::atoll(shape.c_str() + pos));
+      pos = shape.find_first_not_of("0123456789", pos);
+      if (pos == std::string::npos) {
+        break;
+      }
+    }
+  }
+
+  return out;
+}
+
+
+// the part of a .npy array (all of it in 'flat') with its first 'dim' indexes chosen, which puts
+// its first item at 'offset': the items themselves in the last dimension, or else a list of lists
+std::shared_ptr<ObjectList> npy_nested(
+  const std::shared_ptr<ObjectList>& flat,
+  int64_t offset,
+  const std::vector<int64_t>& shape,
+  const std::vector<int64_t>& strides,
+  int dim
+) {
+  if (shape.empty()) {
+    // a zero-dimensional array is one number, but data files are lists, so it's a one-item list
+    return flat;
+  }
+
+  int64_t length = shape[dim];
+  int64_t stride = strides[dim];
+  if (dim == (int)shape.size() - 1) {
+    // a span of the items in C order, or every stride'th item in Fortran order
+    return slice_list(flat, offset, offset + (length - 1) * stride + 1, stride);
+  }
+
+  std::vector<Value> rows;
+  rows.reserve(length);
+  for (int64_t i = 0;  i < length;  i++) {
+    rows.push_back(Value(npy_nested(flat, offset + i * stride, shape, strides, dim + 1)));
+  }
+  return std::make_shared<ObjectListBoxed>(rows);
+}
+
+
+std::shared_ptr<ObjectList> load_npy(const std::string& file_name, const LoadOptions& options) {
+  NpyHeader header = read_npy_header(file_name);
+  check_loadable(header.dtype);
+
+  int64_t count = 1;
+  for (int64_t length : header.shape) {
+    count *= length;
+  }
+  int64_t item_size = dtype_size(header.dtype);
+
+  std::shared_ptr<ObjectList> flat;
+#if HAVE_PREAD
+  if (options.stream  &&  header.dtype == DTYPE_INT32  &&  !header.swap_bytes  &&  header.shape.size() == 1  &&
+      header.data_offset % sizeof(int32_t) == 0) {
+    flat = load_int32_stream(file_name, options, header.data_offset);
+  }
+#endif
+  if (!flat) {
+    FileBytes bytes = file_bytes(file_name, options);
+    const char* data = bytes.data + header.data_offset;
+    std::shared_ptr<const void> storage = bytes.storage;
+    if ((int64_t)bytes.length < header.data_offset + count * item_size) {
+      throw std::runtime_error("file is shorter than its .npy header says: " + file_name);
+    }
+
+    if (header.swap_bytes) {
+      // the only case that can't use the file's bytes as they are
+      std::shared_ptr<std::vector<uint64_t>> words = std::make_shared<std::vector<uint64_t>>(
+        (count * item_size + sizeof(uint64_t) - 1) / sizeof(uint64_t)
+      );
+      char* swapped = reinterpret_cast<char*>(words->data());
+      for (int64_t i = 0;  i < count * item_size;  i += item_size) {
+        std::reverse_copy(data + i, data + i + item_size, swapped + i);
+      }
+      data = swapped;
+      storage = words;
+    }
+
+    flat = make_array(header.dtype, data, count, storage);
+  }
+  if (flat->size() < count) {
+    throw std::runtime_error("file is shorter than its .npy header says: " + file_name);
+  }
+  if (flat->size() > count) {
+    flat = slice_list(flat, 0, count, 1);
+  }
+
+  // how far apart items are in 'flat' for each index
+  std::vector<int64_t> strides(header.shape.size());
+  int64_t stride = 1;
+  for (int i = 0;  i < (int)header.shape.size();  i++) {
+    int dim = header.fortran_order ? i : header.shape.size() - 1 - i;
+    strides[dim] = stride;
+    stride *= header.shape[dim];
+  }
+
+  return npy_nested(flat, 0, header.shape, strides, 0);
+}
+
+
+std::shared_ptr<ObjectList> load_variable(std::string& var_name, const std::string& file_name, const LoadOptions& options) {
+  // the dtype is given as name:dtype=path, or else it's the file's suffix (or a .npy file's header)
+  bool npy = file_name.size() >= 4  &&  file_name.compare(file_name.size() - 4, 4, ".npy") == 0;
+  DType dtype = suffix_dtype(file_name);
+  std::string::size_type colon = var_name.find(':');
+  if (colon != std::string::npos  &&  npy) {
+    throw std::runtime_error("the dtype of a .npy file is in the file: " + file_name);
+  }
+  if (colon != std::string::npos) {
+    if (!parse_dtype(var_name.substr(colon + 1), dtype)) {
+      throw std::runtime_error("unrecognized dtype: " + var_name.substr(colon + 1) + " (the dtypes are int8, uint8, int16, uint16, int32, uint32, int64, uint64)");
+    }
+    var_name = var_name.substr(0, colon);
+  }
+
+  return npy ? load_npy(file_name, options) : load_data(file_name, dtype, options);
+}
+
+
+//// Arrow /////////////////////////////////////////////////////////////////
+
+
+// Arrow's format string for each DType
+const char* const ARROW_FORMATS[] = { "c", "C", "s", "S", "i", "I", "l", "L", "f", "g" };
+
+
+// what an exported array owns
+struct ArrowExport {
+  std::shared_ptr<ObjectList> list;   // keeps the items alive
+  const void* buffers[2];             // no validity bitmap (there are no nulls), then the items
+};
+
+
+void release_arrow_schema(ArrowSchema* schema) {
+  schema->release = nullptr;
+}
+
+
+void release_arrow_array(ArrowArray* array) {
+  delete static_cast<ArrowExport*>(array->private_data);
+  array->release = nullptr;
+}
+
+
+void export_arrow(const std::shared_ptr<ObjectList>& list, ArrowSchema* schema, ArrowArray* array) {
+  std::unique_ptr<ArrowExport> exported(new ArrowExport());
+  DType dtype = DTYPE_INT32;
+  const void* data = nullptr;
+
+  const ObjectListInt32* list_int32 = as_list_int32(list.get());
+  const ObjectListArrayBase* list_array = as_list_array(list.get());
+  if (list_int32) {
+    exported->list = list;
+    data = list_int32->data();
+  }
+  else if (list_array) {
+    exported->list = list;
+    dtype = list_array->dtype();
+    switch (dtype) {
+#define CASE(DTYPE, T) case DTYPE: data = static_cast<const ObjectListArray<T>*>(list_array)->data(); break;
+      FOR_EACH_ARRAY_DTYPE(CASE)
+#undef CASE
+      default: break;
+    }
+  }
+  else {
+    // anything else (a rope, range, slice, ...) is copied into one array
+    std::vector<int32_t> copy;
+    if (!int32_items(list.get(), copy)  &&  list->size() != 0) {
+      throw std::runtime_error("only lists of integers can be exported to Arrow");
+    }
+    std::shared_ptr<ObjectListInt32> owned = std::make_shared<ObjectListInt32>(std::move(copy));
+    exported->list = owned;
+    data = owned->data();
+  }
+
+  // Arrow wants a buffer even for no items
+  static const int64_t no_items = 0;
+  exported->buffers[0] = nullptr;
+  exported->buffers[1] = data ? data : &no_items;
+
+  schema->format = ARROW_FORMATS[dtype];
+  schema->name = "";
+  schema->metadata = nullptr;
+  schema->flags = 0;
+  schema->n_children = 0;
+  schema->children = nullptr;
+  schema->dictionary = nullptr;
+  schema->release = release_arrow_schema;
+  schema->private_data = nullptr;
+
+  array->length = list->size();
+  array->null_count = 0;
+  array->offset = 0;
+  array->n_buffers = 2;
+  array->n_children = 0;
+  array->buffers = exported->buffers;
+  array->children = nullptr;
+  array->dictionary = nullptr;
+  array->release = release_arrow_array;
+  array->private_data = exported.release();
+}
+
+
+std::shared_ptr<ObjectList> import_arrow(ArrowSchema* schema, ArrowArray* array) {
+  // the array is moved into storage that releases it when the last list using it is gone
+  std::shared_ptr<ArrowArray> owned(new ArrowArray(*array), [](ArrowArray* array) {
+    if (array->release) {
+      array->release(array);
+    }
+    delete array;
+  });
+  array->release = nullptr;
+
+  std::string format = schema->format ? schema->format : "";
+  bool dictionary = schema->dictionary != nullptr;
+  if (schema->release) {
+    schema->release(schema);
+  }
+
+  int dtype = -1;
+  for (int i = 0;  i <= DTYPE_UINT64;  i++) {
+    if (format == ARROW_FORMATS[i]) {
+      dtype = i;
+    }
+  }
+  if (dtype == -1  ||  dictionary  ||  owned->n_buffers != 2) {
+    throw std::runtime_error("Arrow arrays with format '" + format + "' can't be imported: only integer arrays can");
+  }
+  if (owned->null_count != 0  &&  owned->buffers[0] != nullptr) {
+    throw std::runtime_error("Arrow arrays with nulls can't be imported");
+  }
+
+  const char* data = static_cast<const char*>(owned->buffers[1]) + owned->offset * dtype_size((DType)dtype);
+  return make_array((DType)dtype, data, owned->length, owned);
 }
 
 
-std::shared_ptr<Object> ObjectFunctionMul::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
-) {
-  if (args.size() != 2) {
-    throw error(stack, "'mul' function takes exactly 2 arguments");
-  }
+//// embedding /////////////////////////////////////////////////////////////
 
-  std::shared_ptr<ObjectInt> arg0_int = std::dynamic_pointer_cast<ObjectInt>(args[0]);
-  std::shared_ptr<ObjectInt> arg1_int = std::dynamic_pointer_cast<ObjectInt>(args[1]);
 
-  if (arg0_int  &&  arg1_int) {
-    return std::make_shared<ObjectInt>(arg0_int->value() * arg1_int->value());
-  }
+std::shared_ptr<Scope> make_global_scope() {
+  std::shared_ptr<Scope> scope = std::make_shared<Scope>(nullptr);
 
-  else {
-    throw error(stack, "'mul' function's arguments must both be integers");
-  }
+  std::vector<ASTNode*> stack;
+  scope->assign(global_address("add"), std::make_shared<ObjectFunctionAdd>(), stack);
+  scope->assign(global_address("mul"), std::make_shared<ObjectFunctionMul>(), stack);
+  scope->assign(global_address("get"), std::make_shared<ObjectFunctionGet>(), stack);
+  scope->assign(global_address("len"), std::make_shared<ObjectFunctionLen>(), stack);
+  scope->assign(global_address("slice"), std::make_shared<ObjectFunctionSlice>(), stack);
+  scope->assign(global_address("range"), std::make_shared<ObjectFunctionRange>(), stack);
+  scope->assign(global_address("map"), std::make_shared<ObjectFunctionMap>(), stack);
+  scope->assign(global_address("reduce"), std::make_shared<ObjectFunctionReduce>(), stack);
+  scope->assign(global_address("threads"), std::make_shared<ObjectFunctionThreads>(), stack);
+
+  return scope;
 }
 
 
-std::string ObjectFunctionGet::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
-  }
+Address global_address(const std::string& name) {
+  return Address(ADDRESS_GLOBAL, intern(name), -1);
+}
 
-  remaining -= 24;
 
-  return "<builtin function 'get'>";
-}
+// the C API (baby-python.h)
 
+struct bp_interpreter {
+  std::shared_ptr<Scope> scope;
+  Value result;
+  std::string error;
+  std::string repr;   // of 'result', if bp_result_repr has been asked for it
+  std::unordered_map<std::string, ScriptLine> parsed;   // by source, so repeated bp_evals don't re-parse
+};
 
-std::shared_ptr<Object> ObjectFunctionGet::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
-) {
-  if (args.size() != 2) {
-    throw error(stack, "'get' function takes exactly 2 arguments");
-  }
 
-  std::shared_ptr<ObjectList> arg0_list = std::dynamic_pointer_cast<ObjectList>(args[0]);
-  std::shared_ptr<ObjectInt> arg1_int = std::dynamic_pointer_cast<ObjectInt>(args[1]);
+// bp_eval's cache is emptied when it gets this big
+const int MAX_PARSED = 1024;
 
-  if (arg0_list  &&  arg1_int) {
-    return arg0_list->values()[arg1_int->value()];
-  }
 
-  else {
-    throw error(stack, "'get' function's arguments must be a list (first) and an integer (second)");
+// returns 0 after running 'body', or -1 if it throws (exceptions must not get out to C)
+template <typename Body>
+int bp_call(bp_interpreter* interpreter, Body body) {
+  try {
+    body();
+    return 0;
+  }
+  catch (std::exception const& exception) {
+    interpreter->error = exception.what();
   }
+  catch (...) {
+    interpreter->error = "unknown error";
+  }
+  return -1;
 }
 
 
-std::string ObjectFunctionLen::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
+// the result, if it's a list (a runtime_error otherwise)
+std::shared_ptr<ObjectList> result_list(const bp_interpreter* interpreter) {
+  if (!as_list(interpreter->result.object())) {
+    throw std::runtime_error("the result isn't a list");
   }
+  return std::static_pointer_cast<ObjectList>(interpreter->result.shared_object());
+}
 
-  remaining -= 24;
 
-  return "<builtin function 'len'>";
+int bp_api_version(void) {
+  return BP_API_VERSION;
 }
 
 
-std::shared_ptr<Object> ObjectFunctionLen::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
-) {
-  if (args.size() != 1) {
-    throw error(stack, "'len' function takes exactly 1 argument");
+bp_interpreter* bp_create(void) {
+  try {
+    std::unique_ptr<bp_interpreter> interpreter(new bp_interpreter());
+    interpreter->scope = make_global_scope();
+    return interpreter.release();
   }
+  catch (...) {
+    return nullptr;
+  }
+}
 
-  std::shared_ptr<ObjectList> arg0_list = std::dynamic_pointer_cast<ObjectList>(args[0]);
 
-  if (arg0_list) {
-    return std::make_shared<ObjectInt>(arg0_list->values().size());
-  }
+void bp_destroy(bp_interpreter* interpreter) {
+  delete interpreter;
+}
 
-  else {
-    throw error(stack, "'len' function's argument must be a list");
-  }
+
+const char* bp_error(const bp_interpreter* interpreter) {
+  return interpreter->error.c_str();
 }
 
 
-std::string ObjectFunctionMap::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
+int bp_set_threads(int threads) {
+  if (threads < 0  ||  threads > max_threads()) {
+    return -1;
   }
+  num_threads = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+  return 0;
+}
 
-  remaining -= 24;
 
-  return "<builtin function 'map'>";
+int bp_bind_int(bp_interpreter* interpreter, const char* name, int value) {
+  return bp_call(interpreter, [&]() {
+    std::vector<ASTNode*> stack;
+    interpreter->scope->assign(global_address(name), Value(value), stack);
+  });
 }
 
 
-std::shared_ptr<Object> ObjectFunctionMap::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
+int bp_bind_int32(
+  bp_interpreter* interpreter,
+  const char* name,
+  const int32_t* data,
+  int64_t length,
+  void (*release)(void* release_data),
+  void* release_data
 ) {
-  if (args.size() != 2) {
-    throw error(stack, "'map' function takes exactly 2 arguments");
-  }
+  return bp_call(interpreter, [&]() {
+    std::shared_ptr<const void> storage;
+    if (release) {
+      storage = std::shared_ptr<const void>(release_data, [release](const void* release_data) {
+        release(const_cast<void*>(release_data));
+      });
+    }
+    std::vector<ASTNode*> stack;
+    interpreter->scope->assign(
+      global_address(name), std::make_shared<ObjectListInt32>(data, length, storage), stack
+    );
+  });
+}
 
-  std::shared_ptr<ObjectFunction> arg0_function = std::dynamic_pointer_cast<ObjectFunction>(args[0]);
-  std::shared_ptr<ObjectList> arg1_list = std::dynamic_pointer_cast<ObjectList>(args[1]);
 
-  if (arg0_function  &&  arg1_list) {
-    std::vector<std::shared_ptr<Object>> values;
-    for (int i = 0;  i < arg1_list->values().size();  i++) {
-      std::vector<std::shared_ptr<Object>> farg;
-      farg.push_back(arg1_list->values()[i]);
+int bp_load(bp_interpreter* interpreter, const char* name, const char* file_name) {
+  return bp_call(interpreter, [&]() {
+    std::string var_name = name;
+    std::shared_ptr<ObjectList> data = load_variable(var_name, file_name, LoadOptions());
+    std::vector<ASTNode*> stack;
+    interpreter->scope->assign(global_address(var_name), data, stack);
+  });
+}
 
-      std::shared_ptr<Object> result = arg0_function->run(scope, stack, farg);
 
-      values.push_back(result);
-    }
+int bp_bind_arrow(bp_interpreter* interpreter, const char* name, ArrowSchema* schema, ArrowArray* array) {
+  return bp_call(interpreter, [&]() {
+    std::shared_ptr<ObjectList> list = import_arrow(schema, array);
+    std::vector<ASTNode*> stack;
+    interpreter->scope->assign(global_address(name), list, stack);
+  });
+}
 
-    return std::make_shared<ObjectList>(values);
-  }
 
-  else {
-    throw error(stack, "'map' function's arguments must be a function (first) and a list (second)");
+int bp_eval(bp_interpreter* interpreter, const char* source) {
+  interpreter->result.reset();
+  interpreter->repr.clear();
+
+  int status = bp_call(interpreter, [&]() {
+    auto found = interpreter->parsed.find(source);
+    if (found == interpreter->parsed.end()) {
+      if (interpreter->parsed.size() >= MAX_PARSED) {
+        interpreter->parsed.clear();
+      }
+      found = interpreter->parsed.emplace(source, parse_script_line(source, 1)).first;
+    }
+    std::vector<ASTNode*> stack;
+    interpreter->result = run_script_line(found->second, interpreter->scope, stack);
+  });
+
+  if (status != 0  &&  interpreter->error.compare(0, 3, "---") == 0) {
+    // the "---^" arrows point into the line, which the REPL would have shown above them
+    interpreter->error = ">> " + std::string(source) + "\n" + interpreter->error;
   }
+  return status;
 }
 
 
-std::string ObjectFunctionReduce::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
+bp_type bp_result_type(const bp_interpreter* interpreter) {
+  const Value& result = interpreter->result;
+  if (!result) {
+    return BP_NONE;
+  }
+  else if (result.is_int()) {
+    return BP_INT;
   }
+  return result.object()->is_list() ? BP_LIST : BP_FUNCTION;
+}
 
-  remaining -= 21;
 
-  return "<builtin function 'reduce'>";
+const char* bp_result_repr(bp_interpreter* interpreter) {
+  if (interpreter->result  &&  interpreter->repr.empty()) {
+    bp_call(interpreter, [&]() {
+      interpreter->repr = line_repr(interpreter->result);
+    });
+  }
+  return interpreter->repr.c_str();
 }
 
 
-std::shared_ptr<Object> ObjectFunctionReduce::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
-) {
-  if (args.size() == 2) {
-    std::shared_ptr<ObjectFunction> arg0_function = std::dynamic_pointer_cast<ObjectFunction>(args[0]);
-    std::shared_ptr<ObjectList> arg1_list = std::dynamic_pointer_cast<ObjectList>(args[1]);
-
-    if (arg1_list->values().size() == 0) {
-      throw error(stack, "'reduce' function's list argument can only be empty if a third argument (the initial value) is provided");
+int bp_result_int(bp_interpreter* interpreter, int* out) {
+  return bp_call(interpreter, [&]() {
+    if (!interpreter->result.is_int()) {
+      throw std::runtime_error("the result isn't an integer");
     }
+    *out = interpreter->result.to_int();
+  });
+}
+
 
-    std::shared_ptr<Object> result = arg1_list->values()[0];
+int bp_result_length(bp_interpreter* interpreter, int64_t* out) {
+  return bp_call(interpreter, [&]() {
+    *out = result_list(interpreter)->size();
+  });
+}
 
-    for (int i = 1;  i < arg1_list->values().size();  i++) {
-      std::vector<std::shared_ptr<Object>> fargs;
-      fargs.push_back(result);
-      fargs.push_back(arg1_list->values()[i]);
 
-      result = arg0_function->run(scope, stack, fargs);
+int bp_result_int32(bp_interpreter* interpreter, int32_t* out) {
+  return bp_call(interpreter, [&]() {
+    std::shared_ptr<ObjectList> list = result_list(interpreter);
+    std::vector<int32_t> copy;
+    const int32_t* items = int32_items(list.get(), copy);
+    if (!items  &&  list->size() != 0) {
+      throw std::runtime_error("the result's items aren't all integers");
     }
+    std::copy(items, items + list->size(), out);
+  });
+}
 
-    return result;
-  }
 
-  else if (args.size() == 3) {
-    std::shared_ptr<ObjectFunction> arg0_function = std::dynamic_pointer_cast<ObjectFunction>(args[0]);
-    std::shared_ptr<ObjectList> arg1_list = std::dynamic_pointer_cast<ObjectList>(args[1]);
-    std::shared_ptr<Object> result = args[2];
+int bp_export_result(bp_interpreter* interpreter, ArrowSchema* schema, ArrowArray* array) {
+  return bp_call(interpreter, [&]() {
+    export_arrow(result_list(interpreter), schema, array);
+  });
+}
 
-    for (int i = 0;  i < arg1_list->values().size();  i++) {
-      std::vector<std::shared_ptr<Object>> fargs;
-      fargs.push_back(result);
-      fargs.push_back(arg1_list->values()[i]);
 
-      result = arg0_function->run(scope, stack, fargs);
-    }
+//// scripts ///////////////////////////////////////////////////////////////
 
-    return result;
-  }
 
-  else {
-    throw error(stack, "'reduce' function takes either 2 or 3 arguments");
+ScriptLine parse_script_line(const std::string& line, int number) {
+  ScriptLine out;
+  out.number = number;
+  // kept alive by any functions defined on this line, as in the REPL
+  out.arena = std::make_shared<Arena>(line);
+  out.ast = parse_line(tokenize(line), *out.arena);
+  if (eval_mode == EVAL_BYTECODE) {
+    out.code = compile({out.ast});
   }
+  return out;
 }
 
 
-std::string ObjectUserFunction::repr(int& remaining) const {
-  if (remaining < 0) {
-    return "";
+Value run_script_line(const ScriptLine& line, const std::shared_ptr<Scope>& scope, std::vector<ASTNode*>& stack) {
+  if (line.code) {
+    return run_code(*line.code, scope, stack);
   }
+  return line.ast->run(scope, stack);
+}
 
-  remaining -= 23;
 
-  return "<user-defined function>";
+// the line being reported on, as the REPL would have shown it ("---^" arrows point into it)
+std::string script_context(const std::string& name, int number, const std::string& line) {
+  return name + ", line " + std::to_string(number) + ":\n>> " + line + "\n";
 }
 
 
-std::shared_ptr<Object> ObjectUserFunction::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack,
-  std::vector<std::shared_ptr<Object>> args
-) {
-  if (args.size() != fun_->params().size()) {
-    throw error(stack, "wrong number of arguments for user-defined function");
-  }
+std::vector<ScriptLine> parse_script(const std::string& name, std::istream& source) {
+  std::vector<ScriptLine> out;
+  std::string errors;
 
-  std::shared_ptr<Scope> nested_scope(scope);
+  std::string line;
+  for (int number = 1;  std::getline(source, line);  number++) {
+    std::string::size_type first = line.find_first_not_of(" \t\r\v\f");
+    if (first == std::string::npos  ||  line[first] == '#') {
+      continue;
+    }
 
-  for (int i = 0;  i < args.size();  i++) {
-    nested_scope->assign(fun_->params()[i], args[i], stack);
+    try {
+      std::vector<PosToken> tokens = tokenize(line);
+      if (tokens.size() == 1  &&  tokens[0].text == "exit") {
+        break;
+      }
+      if (errors.empty()) {
+        out.push_back(parse_script_line(line, number));
+      }
+      else {
+        // nothing will run, so there's no need to keep (or compile) it
+        std::shared_ptr<Arena> arena = std::make_shared<Arena>(line);
+        parse_line(tokens, *arena);
+      }
+    }
+    catch (std::runtime_error const& exception) {
+      errors += script_context(name, number, line) + exception.what() + "\n";
+    }
   }
 
-  std::shared_ptr<Object> out;
-  for (int i = 0;  i < fun_->body().size();  i++) {
-    out = fun_->body()[i]->run(nested_scope, stack);
+  if (!errors.empty()) {
+    errors.pop_back();
+    throw std::runtime_error(errors);
   }
   return out;
 }
 
 
-//// ASTNodes //////////////////////////////////////////////////////////////
+bool run_script(const std::vector<ScriptLine>& script, const std::string& name, const std::shared_ptr<Scope>& scope) {
+  for (const ScriptLine& line : script) {
+    std::vector<ASTNode*> stack;
+    LineStats stats;
+    bytes_streamed = 0;
+    try {
+      Value result = run_script_line(line, scope, stack);
+      stats.run = stats.lap();
+      if (result) {
+        std::string repr = line_repr(result);
+        stats.repr = stats.lap();
+        std::cout << repr << "\n";
+      }
+      // timings, including the streaming rate, only with --stats, so that the output is just the results
+      if (show_stats) {
+        std::cout << stats.report() << "\n";
+        if (bytes_streamed > 0) {
+          double megabytes = bytes_streamed / 1e6;
+          std::cout << "(streamed " << megabytes << " MB at " << megabytes / 1e3 / stats.run << " GB/s)\n";
+        }
+      }
+    }
+    catch (std::runtime_error const& exception) {
+      std::cout << script_context(name, line.number, line.arena->line()) << exception.what() << std::endl;
+      return false;
+    }
+  }
+  std::cout.flush();
+  return true;
+}
 
 
-std::shared_ptr<Object> ASTLiteralInt::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  return std::make_shared<ObjectInt>(value_);
+std::string line_repr(const Value& result) {
+  int remaining = MAX_REPR;
+  std::string repr = result.repr(remaining);
+  if (repr.size() > MAX_REPR) {
+    repr = repr.substr(0, MAX_REPR - 3) + "...";
+  }
+  return repr;
 }
 
 
-std::shared_ptr<Object> ASTLiteralList::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  std::vector<std::shared_ptr<Object>> values;
+bool stdin_is_terminal() {
+#if !defined(_WIN32)
+  return isatty(0);
+#else
+  return _isatty(_fileno(stdin));
+#endif
+}
 
-  for (int i = 0;  i < values_.size();  i++) {
-    values.push_back(values_[i]->run(scope, stack));
-  }
 
-  return std::make_shared<ObjectList>(values);
-}
+//// statistics ////////////////////////////////////////////////////////////
 
 
-std::shared_ptr<Object> ASTDefineFun::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  return std::make_shared<ObjectUserFunction>(shared_from_this());
+int64_t peak_rss() {
+#if !defined(_WIN32)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return usage.ru_maxrss;          // bytes
+#else
+  return usage.ru_maxrss * 1024;   // kilobytes
+#endif
+#else
+  return 0;
+#endif
 }
 
 
-std::shared_ptr<Object> ASTCallNamed::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  if (stack.size() == MAX_RECURSION) {
-    throw error(stack, "recursion is too deep (probably an infinite loop)");
-  }
+LineStats::LineStats()
+  : last_(std::chrono::high_resolution_clock::now())
+  , allocations_(num_allocations)
+  , bytes_(bytes_allocated) { }
 
-  std::shared_ptr<Object> maybe_fun = scope->get(name_, stack);
 
-  std::shared_ptr<ObjectFunction> fun = std::dynamic_pointer_cast<ObjectFunction>(maybe_fun);
+double LineStats::lap() {
+  auto now = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = now - last_;
+  last_ = now;
+  return duration.count();
+}
 
-  if (!fun) {
-    throw error(stack, "attempting to call an object that is not a function");
-  }
 
-  std::vector<std::shared_ptr<Object>> args;
-  for (int i = 0;  i < args_.size();  i++) {
-    args.push_back(args_[i]->run(scope, stack));
+std::string LineStats::report() const {
+  const char* names[] = {"tokenize", "parse", "compile", "run", "repr"};
+  const double seconds[] = {tokenize, parse, compile, run, repr};
+
+  std::ostringstream out;
+  out << "(";
+  bool first = true;
+  for (int i = 0;  i < 5;  i++) {
+    if (seconds[i] >= 0.0) {
+      out << (first ? "" : ", ") << names[i] << " " << seconds[i];
+      first = false;
+    }
+  }
+  out << " seconds; " << num_allocations - allocations_ << " allocations, ";
+  out << (bytes_allocated - bytes_) / 1e6 << " MB";
+  int64_t rss = peak_rss();
+  if (rss > 0) {
+    out << "; peak RSS " << rss / 1e6 << " MB";
   }
+  out << ")";
+  return out.str();
+}
 
-  std::shared_ptr<Scope> nested_scope = std::make_shared<Scope>(scope);
 
-  stack.push_back(shared_from_this());
-  std::shared_ptr<Object> result = fun->run(nested_scope, stack, args);
-  stack.pop_back();
+//// main function /////////////////////////////////////////////////////////
 
-  return result;
+
+#ifndef BABY_PYTHON_LIBRARY
+// --stats counts allocations here (new[] and the nothrow forms call this, and the standard
+// library's operator delete frees what malloc allocated)
+void* operator new(std::size_t size) {
+  if (show_stats) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+  }
+  while (true) {
+    void* out = std::malloc(size == 0 ? 1 : size);
+    if (out) {
+      return out;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
 }
 
 
-std::shared_ptr<Object> ASTAssignment::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  std::shared_ptr<Object> result = value_->run(scope, stack);
+// a data file argument's variable and list, printing how long it took to load if 'report'
+std::pair<Address, std::shared_ptr<ObjectList>> load_data_arg(const std::string& arg, const LoadOptions& options, bool report) {
+  std::string::size_type pos = arg.find('=');
+  std::string var_name = arg.substr(0, pos);
+  std::string file_name = arg.substr(pos + 1, -1);
 
-  scope->assign(name_, result, stack);
+  auto start = std::chrono::high_resolution_clock::now();
+  std::shared_ptr<ObjectList> data = load_variable(var_name, file_name, options);
+  auto stop = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = stop - start;
 
-  return result;
+  if (report) {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    double megabytes = (double)file.tellg() / 1e6;
+    if (data->type() == OBJECT_LIST_STREAM) {
+      std::cout << "(streaming " << arg << ": " << megabytes << " MB, read as it's used)" << std::endl;
+    }
+    else if (options.use_mmap  &&  !options.populate) {
+      std::cout << "(mapped " << arg << ": " << megabytes << " MB, read as it's used)" << std::endl;
+    }
+    else {
+      // read or paged in, so the time is the time it took to read all of it
+      std::cout << "(loaded " << arg << ": " << megabytes << " MB in " << duration.count() << " seconds, "
+                << megabytes / 1e3 / duration.count() << " GB/s)" << std::endl;
+    }
+  }
+
+  return std::make_pair(global_address(var_name), data);
 }
 
 
-std::shared_ptr<Object> ASTDelete::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  return scope->del(name_, stack);
-}
+// -f or a pipe: the script is parsed before anything is loaded, then run once for each of the files
+// given to a variable that's given several (the others are loaded once and shared by every run)
+int run_batch(const std::string& script_name, const std::vector<std::string>& data_args, const LoadOptions& load_options) {
+  std::string name = script_name.empty() ? "<stdin>" : script_name;
+  std::vector<ScriptLine> script;
+  LineStats stats;
+  try {
+    if (script_name.empty()) {
+      script = parse_script(name, std::cin);
+    }
+    else {
+      std::ifstream file(script_name);
+      if (!file) {
+        std::cout << "could not open script " << script_name << std::endl;
+        return -1;
+      }
+      script = parse_script(name, file);
+    }
+  }
+  catch (std::runtime_error const& exception) {
+    std::cout << exception.what() << std::endl;
+    return -1;
+  }
+  if (show_stats) {
+    // tokenizing and compiling, too, for all of the lines at once
+    stats.parse = stats.lap();
+    std::cout << stats.report() << std::endl;
+  }
 
+  // the arguments for each variable (without its ':dtype'), in the order they first appear
+  std::vector<std::pair<std::string, std::vector<std::string>>> variables;
+  for (const std::string& arg : data_args) {
+    std::string var_name = arg.substr(0, std::min(arg.find('='), arg.find(':')));
+    auto found = std::find_if(variables.begin(), variables.end(), [&](const std::pair<std::string, std::vector<std::string>>& variable) {
+      return variable.first == var_name;
+    });
+    if (found == variables.end()) {
+      variables.emplace_back(var_name, std::vector<std::string>());
+      found = variables.end() - 1;
+    }
+    found->second.push_back(arg);
+  }
 
-std::shared_ptr<Object> ASTIdentifier::run(
-  std::shared_ptr<Scope> scope,
-  std::vector<std::shared_ptr<ASTNode>>& stack
-) {
-  return scope->get(name_, stack);
-}
+  int num_runs = 1;
+  for (const auto& variable : variables) {
+    int num_files = variable.second.size();
+    if (num_files > 1  &&  num_runs > 1  &&  num_files != num_runs) {
+      std::cout << "variables given several files must all be given the same number of them" << std::endl;
+      return -1;
+    }
+    num_runs = std::max(num_runs, num_files);
+  }
+
+  // like the timings, data files are only listed with --stats, so that the output is just the results
+  std::vector<std::pair<Address, std::shared_ptr<ObjectList>>> shared;
+  for (const auto& variable : variables) {
+    if (variable.second.size() == 1) {
+      try {
+        shared.push_back(load_data_arg(variable.second[0], load_options, show_stats));
+      }
+      catch (std::runtime_error const& exception) {
+        std::cout << exception.what() << std::endl;
+        return -1;
+      }
+    }
+  }
 
+  bool ok = true;
+  for (int run = 0;  run < num_runs;  run++) {
+    // each run starts from nothing but the built-ins and its data
+    std::shared_ptr<Scope> scope = make_global_scope();
+    std::vector<ASTNode*> stack;
+    for (const auto& data : shared) {
+      scope->assign(data.first, data.second, stack);
+    }
 
-//// main function /////////////////////////////////////////////////////////
+    if (num_runs > 1) {
+      std::string header = "#";
+      for (const auto& variable : variables) {
+        if (variable.second.size() > 1) {
+          header += " " + variable.second[run];
+        }
+      }
+      std::cout << header << std::endl;
+    }
 
+    try {
+      for (const auto& variable : variables) {
+        if (variable.second.size() > 1) {
+          std::pair<Address, std::shared_ptr<ObjectList>> data = load_data_arg(variable.second[run], load_options, show_stats);
+          scope->assign(data.first, data.second, stack);
+        }
+      }
+    }
+    catch (std::runtime_error const& exception) {
+      std::cout << exception.what() << std::endl;
+      ok = false;
+      continue;
+    }
 
-int main(int argc, char** argv) {
-  // create a variable Scope
-  std::shared_ptr<Scope> scope = std::make_shared<Scope>(nullptr);
+    ok = run_script(script, name, scope)  &&  ok;
+  }
+
+  return ok ? 0 : -1;
+}
 
-  // and put some built-ins in it
-  std::vector<std::shared_ptr<ASTNode>> stack;
-  scope->assign("add", std::make_shared<ObjectFunctionAdd>(), stack);
-  scope->assign("mul", std::make_shared<ObjectFunctionMul>(), stack);
-  scope->assign("get", std::make_shared<ObjectFunctionGet>(), stack);
-  scope->assign("len", std::make_shared<ObjectFunctionLen>(), stack);
-  scope->assign("map", std::make_shared<ObjectFunctionMap>(), stack);
-  scope->assign("reduce", std::make_shared<ObjectFunctionReduce>(), stack);
 
-  // use the command-line arguments to add some data from files
+int main(int argc, char** argv) {
+  // create a variable Scope with some built-ins in it
+  std::shared_ptr<Scope> scope = make_global_scope();
+  std::vector<ASTNode*> stack;
+
+  // command-line options start with "--" (or are -f), and the rest are data files
+  LoadOptions load_options;
+  std::string script_name;
+  std::vector<std::string> data_args;
   for (int argi = 1;  argi < argc;  argi++) {
     std::string arg = argv[argi];
 
-    std::string::size_type pos = arg.find('=');
+    if (arg == "-f") {
+      // run a script, rather than the REPL
+      if (argi + 1 == argc) {
+        std::cout << "-f must be given a script file" << std::endl;
+        return -1;
+      }
+      script_name = argv[++argi];
+    }
+    else if (arg.substr(0, 2) != "--") {
+      data_args.push_back(arg);
+    }
+    else if (arg == "--stats") {
+      // time each phase of each line, count what it allocates, and show the peak memory use
+      show_stats = true;
+    }
+    else if (arg == "--tree-walker") {
+      // run the ASTNodes directly, rather than compiling them to bytecode
+      eval_mode = EVAL_TREE_WALKER;
+    }
+    else if (arg == "--no-jit") {
+      // never compile user-defined functions to machine code
+      jit_enabled = false;
+    }
+    else if (arg == "--no-mmap") {
+      // read data files into memory, rather than mapping them
+      load_options.use_mmap = false;
+    }
+    else if (arg == "--populate") {
+      // map data files with all of their pages loaded up front
+      load_options.populate = true;
+    }
+    else if (arg == "--stream") {
+      // read data files a window at a time as they're used, rather than holding them in memory
+      load_options.stream = true;
+    }
+    else if (arg.substr(0, 14) == "--window-size=") {
+      // items per window when streaming
+      load_options.window_size = std::atoll(arg.substr(14).c_str());
+      if (load_options.window_size < 1) {
+        std::cout << "--window-size must be given a positive number of items" << std::endl;
+        return -1;
+      }
+    }
+    else if (arg.substr(0, 13) == "--read-ahead=") {
+      // windows being read at once while streaming, ahead of the one being used
+      load_options.read_ahead = std::atoi(arg.substr(13).c_str());
+      if (load_options.read_ahead < 1) {
+        std::cout << "--read-ahead must be given a positive number of windows" << std::endl;
+        return -1;
+      }
+    }
+    else if (arg == "--no-io-uring") {
+      // stream with pread on background threads, even where io_uring is available
+      load_options.use_io_uring = false;
+    }
+    else if (arg.substr(0, 10) == "--threads=") {
+      // map and reduce over large lists on this many threads (0 means one per core)
+      std::string number = arg.substr(10);
+      bool digits = !number.empty()  &&  number.size() <= 9  &&
+                    std::all_of(number.begin(), number.end(), [](char c) { return c >= '0'  &&  c <= '9'; });
+      num_threads = digits ? std::atoi(number.c_str()) : -1;
+      if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+      }
+      if (num_threads < 1  ||  num_threads > max_threads()) {
+        std::cout << "--threads must be given a number from 1 to " << max_threads() << ", or 0 for one per core" << std::endl;
+        return -1;
+      }
+    }
+    else {
+      std::cout << "unrecognized option: " << arg << std::endl;
+      return -1;
+    }
+  }
+
+  for (const std::string& arg : data_args) {
     if (arg.find('=') == std::string::npos) {
       std::cout << "arguments must be separated by '=', as in: data=/path/to/data.int32" << std::endl;
       return -1;
     }
+  }
 
-    std::string var_name = arg.substr(0, pos);
-    std::string file_name = arg.substr(pos + 1, -1);
+  // a script, or whatever is piped in, is parsed all at once and run without the REPL
+  if (!script_name.empty()  ||  !stdin_is_terminal()) {
+    return run_batch(script_name, data_args, load_options);
+  }
 
-    std::ifstream file(file_name, std::ios::binary);
-    if (!file) {
-      std::cout << "could not open file: " << file_name << std::endl;
-      return -1;
+  // use the rest of the command-line arguments to add some data from files
+  for (const std::string& arg : data_args) {
+    try {
+      std::pair<Address, std::shared_ptr<ObjectList>> data = load_data_arg(arg, load_options, true);
+      scope->assign(data.first, data.second, stack);
     }
-
-    std::vector<std::shared_ptr<Object>> values;
-    int32_t raw;
-    while (file.read(reinterpret_cast<char*>(&raw), sizeof(raw))) {
-      values.push_back(std::make_shared<ObjectInt>(raw));
+    catch (std::runtime_error const& exception) {
+      std::cout << exception.what() << std::endl;
+      return -1;
     }
-
-    file.close();
-
-    scope->assign(var_name, std::make_shared<ObjectList>(values), stack);
   }
 
   // baby-python startup screen!
@@ -1243,67 +6096,77 @@ int main(int argc, char** argv) {
     }
     linenoise::AddHistory(line.c_str());
 
-    // parse the line in two steps
+    // parse the line: break it into tokens, build an AST tree from them, and work out where
+    // each variable it names will be found
+    LineStats stats;
     std::vector<PosToken> tokens;
-    int i = 0;
-    std::shared_ptr<ASTNode> ast;
+    // every ASTNode from this line, kept alive by any functions defined on it
+    std::shared_ptr<Arena> arena = std::make_shared<Arena>(line);
+    ASTNode* ast = nullptr;
+    std::shared_ptr<Code> code;
     try {
-      // (1) break the whole string into a list of tokens
       tokens = tokenize(line);
-      // (2) build an AST tree from the tokens
-      ast = parse(i, tokens, line);
+      stats.tokenize = stats.lap();
+      ast = parse_line(tokens, *arena);
+      stats.parse = stats.lap();
+      if (eval_mode == EVAL_BYTECODE) {
+        code = compile({ast});
+        stats.compile = stats.lap();
+      }
     }
     catch (std::runtime_error const& exception) {
       // syntax error while tokenizing or building AST
       std::cout << exception.what() << std::endl;
     }
 
-    if (tokens.size() == 1  &&  tokens[0].second == "exit") {
+    if (tokens.size() == 1  &&  tokens[0].text == "exit") {
       linenoise::SaveHistory(".baby-python-history");
       break;
     }
 
     if (ast) {
-      if (i < tokens.size()) {
-        // unused tokens after building a whole AST is an error
-        std::cout << error_arrow(tokens[i].first);
-        std::cout << "complete expression, but line doesn't end" << std::endl;
-      }
+      // create a new stack and attempt to run the AST
+      std::vector<ASTNode*> stack;
+      Value result;
 
-      else {
-        // create a new stack and attempt to run the AST
-        std::vector<std::shared_ptr<ASTNode>> stack;
-        std::shared_ptr<Object> result(nullptr);
+      bytes_streamed = 0;
+      stats.lap();
 
-        auto start = std::chrono::high_resolution_clock::now();
+      try {
+        result = code ? run_code(*code, scope, stack) : ast->run(scope, stack);
+      }
+      catch (std::runtime_error const& exception) {
+        std::cout << exception.what() << std::endl;
+      }
 
-        try {
-          result = ast->run(scope, stack);
-        }
-        catch (std::runtime_error const& exception) {
-          std::cout << exception.what() << std::endl;
-        }
+      stats.run = stats.lap();
 
-        auto stop = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> duration = stop - start;
+      if (result) {
+        // execution was successful! print the result!
+        std::string repr = line_repr(result);
+        stats.repr = stats.lap();
+        std::cout << repr << std::endl;
+      }
 
-        if (result) {
-          // execution was successful! print the result!
-          int remaining = MAX_REPR;
-          std::string repr = result->repr(remaining);
-          if (repr.size() > MAX_REPR) {
-            repr = repr.substr(0, MAX_REPR - 3) + "...";
-          }
-          std::cout << repr << std::endl;
-          std::cout << "(" << duration.count() << " seconds)" << std::endl;
-        }
+      if (show_stats) {
+        std::cout << stats.report() << std::endl;
+      }
+      else if (result) {
+        std::cout << "(" << stats.run << " seconds)" << std::endl;
+      }
 
+      if (bytes_streamed > 0) {
+        // including the time spent computing, not just reading
+        double megabytes = bytes_streamed / 1e6;
+        std::cout << "(streamed " << megabytes << " MB at " << megabytes / 1e3 / stats.run << " GB/s)" << std::endl;
       }
+
     }
   }
 
   return 0;
 }
+#endif
 
 
 //// The end! (About half as much code as the line-editor.)
@@ -0,0 +1,111 @@
+/* baby-python as a library, for programs that keep an interpreter (and its data) around and run
+ * many expressions in it. Build it from the same source as the REPL, without main():
+ *
+ *     c++ -std=c++11 -O3 -pthread -fPIC -shared -DBABY_PYTHON_LIBRARY baby-python.cpp -o libbabypython.so
+ *
+ * Functions that can fail return 0 on success and -1 on failure, after which bp_error says why.
+ * Calls must not overlap, even on different interpreters: the names of variables are shared.
+ */
+
+#ifndef BABY_PYTHON_H
+#define BABY_PYTHON_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the Arrow C Data Interface, as its specification defines it (no Arrow library is needed) */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+  void (*release)(struct ArrowSchema*);
+  void* private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+  void (*release)(struct ArrowArray*);
+  void* private_data;
+};
+
+#endif
+
+/* bumped when anything below changes incompatibly */
+#define BP_API_VERSION 1
+
+int bp_api_version(void);
+
+typedef struct bp_interpreter bp_interpreter;
+
+/* a global scope with the built-in functions in it */
+bp_interpreter* bp_create(void);
+void bp_destroy(bp_interpreter* interpreter);
+
+/* why the last call on 'interpreter' that returned -1 failed (for bp_eval, after the line, as
+ * ">> line", with "---^" arrows pointing into it, as the REPL shows it) */
+const char* bp_error(const bp_interpreter* interpreter);
+
+/* for every interpreter in the process, like --threads=N (0 for one per core; at most 4 per core
+ * or 64, whichever is more) */
+int bp_set_threads(int num_threads);
+
+/* assigns a variable: an integer, or a list of the 'length' int32s at 'data', which aren't copied
+ * ('release', if not NULL, is called with 'release_data' when baby-python is done with them) */
+int bp_bind_int(bp_interpreter* interpreter, const char* name, int value);
+int bp_bind_int32(
+  bp_interpreter* interpreter,
+  const char* name,
+  const int32_t* data,
+  int64_t length,
+  void (*release)(void* release_data),
+  void* release_data
+);
+
+/* assigns a variable to a data file, as name=path on the command line does (.npy files, too) */
+int bp_load(bp_interpreter* interpreter, const char* name, const char* file_name);
+
+/* assigns a variable to an integer Arrow array without nulls, sharing its memory; takes
+ * ownership of both structs (releasing the array when baby-python is done with it) */
+int bp_bind_arrow(bp_interpreter* interpreter, const char* name, struct ArrowSchema* schema, struct ArrowArray* array);
+
+/* runs one line of code; its result is kept until the next bp_eval */
+int bp_eval(bp_interpreter* interpreter, const char* source);
+
+enum bp_type { BP_NONE, BP_INT, BP_LIST, BP_FUNCTION };
+
+enum bp_type bp_result_type(const bp_interpreter* interpreter);
+/* the result as the REPL would print it (valid until the next call on 'interpreter') */
+const char* bp_result_repr(bp_interpreter* interpreter);
+int bp_result_int(bp_interpreter* interpreter, int* out);
+int bp_result_length(bp_interpreter* interpreter, int64_t* out);
+/* copies all of a list's items, which must be integers, into 'out' (bp_result_length of them) */
+int bp_result_int32(bp_interpreter* interpreter, int32_t* out);
+/* a list result as an Arrow array, sharing its memory (the caller releases both structs) */
+int bp_export_result(bp_interpreter* interpreter, struct ArrowSchema* schema, struct ArrowArray* array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif